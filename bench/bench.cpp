@@ -0,0 +1,443 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  bench.cpp
+//  Created 2026-10-18
+//
+//  Measures Elsa operations against hand-written equivalents using the raw C API.
+//  Usage: elsa_bench [--csv] [--filter <substring>] [--time <milliseconds>]
+//
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <lua.hpp>
+#include <elsa.hpp>
+
+
+
+//
+// Allocation counting: C++ allocations through the global operator new and Lua
+// allocations through the lua_Alloc of the benchmarked state.
+//
+
+static std::atomic<std::size_t> cpp_allocations { 0 };
+static std::atomic<std::size_t> lua_allocations { 0 };
+
+void* operator new(std::size_t size) {
+    cpp_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* block = std::malloc(size ? size : 1)) return block;
+    throw std::bad_alloc();
+}
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+void operator delete(void* block, std::size_t) noexcept {
+    std::free(block);
+}
+
+static void* counting_alloc(void*, void* block, std::size_t, std::size_t nsize) {
+    if(nsize == 0) {
+        std::free(block);
+        return nullptr;
+    }
+    if(!block) lua_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::realloc(block, nsize);
+}
+
+// keep the compiler from discarding benchmarked results
+template<typename T>
+inline void keep(T&& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+
+
+struct measurement {
+    std::string name;
+    std::string variant;
+    std::size_t iterations;
+    double ns_per_op;
+    double cpp_allocs_per_op;
+    double lua_allocs_per_op;
+};
+
+struct benchmark {
+    std::string name;
+    std::function<void(elsa::state&)> elsa;
+    std::function<void(lua_State*)> raw;
+};
+
+static std::chrono::milliseconds min_time { 200 };
+
+template<typename F>
+static measurement measure(const std::string& name, const std::string& variant, F&& run) {
+    // calibrate the batch size so the clock is read rarely
+    std::size_t batch = 1;
+    while(true) {
+        const auto start = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < batch; ++i) run();
+        if(std::chrono::steady_clock::now() - start > std::chrono::milliseconds(1) || batch >= (1u << 24)) break;
+        batch *= 2;
+    }
+    std::size_t iterations = 0;
+    const std::size_t cpp_before = cpp_allocations.load();
+    const std::size_t lua_before = lua_allocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    auto now = start;
+    while(now - start < min_time) {
+        for(std::size_t i = 0; i < batch; ++i) run();
+        iterations += batch;
+        now = std::chrono::steady_clock::now();
+    }
+    const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+    const double count = static_cast<double>(iterations);
+    return {
+        name, variant, iterations, ns / count,
+        static_cast<double>(cpp_allocations.load() - cpp_before) / count,
+        static_cast<double>(lua_allocations.load() - lua_before) / count
+    };
+}
+
+
+
+//
+// Benchmarks
+//
+
+static const char* setup {
+    "a = { b = { c = { d = { e = 1 } } } }\n"
+    "function count(...) return select('#', ...) end\n"
+    "list = {} for i = 1, 1000 do list[i] = i end\n"
+};
+
+static const char* const path[] { "a", "b", "c", "d", "e" };
+
+// state[path[0]][path[1]]...[path[Depth - 1]]
+template<std::size_t Index, std::size_t Depth>
+static elsa::selector chain(elsa::selector&& sel) {
+    if constexpr(Index == Depth) return std::move(sel);
+    else return chain<Index + 1, Depth>(std::move(sel)[path[Index]]);
+}
+
+template<std::size_t Depth>
+static benchmark lookup() {
+    return {
+        "lookup_depth_" + std::to_string(Depth),
+        [](elsa::state& state) {
+            auto sel = chain<1, Depth>(state[path[0]]);
+            sel.push();
+            keep(lua_type(state, -1));
+            lua_pop(state, 1);
+        },
+        [](lua_State* state) {
+            lua_pushglobaltable(state);
+            for(std::size_t i = 0; i < Depth; ++i) {
+                lua_pushstring(state, path[i]);
+                lua_rawget(state, -2);
+                lua_remove(state, -2);
+            }
+            keep(lua_type(state, -1));
+            lua_pop(state, 1);
+        }
+    };
+}
+
+template<std::size_t... N>
+static benchmark call(std::index_sequence<N...>) {
+    constexpr std::size_t arguments { sizeof...(N) };
+    return {
+        "selector_call_args_" + std::to_string(arguments),
+        [](elsa::state& state) {
+            keep(state["count"].call<int>(static_cast<int>(N)...));
+        },
+        [](lua_State* state) {
+            lua_getglobal(state, "count");
+            for(std::size_t i = 0; i < arguments; ++i) lua_pushinteger(state, static_cast<lua_Integer>(i));
+            if(lua_pcall(state, static_cast<int>(arguments), 1, 0)) std::abort();
+            keep(static_cast<int>(lua_tointeger(state, -1)));
+            lua_pop(state, 1);
+        }
+    };
+}
+
+struct particle {
+    double x { 0 }, y { 0 }, z { 0 };
+    int id { 0 };
+};
+namespace elsa {
+    template<> struct table_fields<particle> {
+        static constexpr auto members = std::make_tuple(field { "x", &particle::x }, field { "y", &particle::y },
+            field { "z", &particle::z }, field { "id", &particle::id });
+    };
+}
+
+template<typename T>
+static benchmark push_get(const std::string& type, T value) {
+    return {
+        "push_get_" + type,
+        [value](elsa::state& state) {
+            elsa::utility::push(state, value);
+            keep(elsa::utility::get<T>(state, -1));
+            lua_pop(state, 1);
+        },
+        [value](lua_State* state) {
+            if constexpr(std::is_same<T, bool>::value) {
+                lua_pushboolean(state, value);
+                keep(lua_toboolean(state, -1) != 0);
+            }
+            else if constexpr(std::is_integral<T>::value) {
+                lua_pushinteger(state, static_cast<lua_Integer>(value));
+                keep(static_cast<T>(lua_tointeger(state, -1)));
+            }
+            else if constexpr(std::is_floating_point<T>::value) {
+                lua_pushnumber(state, static_cast<lua_Number>(value));
+                keep(static_cast<T>(lua_tonumber(state, -1)));
+            }
+            else if constexpr(std::is_same<T, std::string>::value) {
+                lua_pushlstring(state, value.data(), value.size());
+                std::size_t length = 0;
+                const char* string = lua_tolstring(state, -1, &length);
+                keep(std::string(string, length));
+            }
+            else if constexpr(std::is_same<T, std::vector<int>>::value) {
+                lua_createtable(state, static_cast<int>(value.size()), 0);
+                for(std::size_t i = 0; i < value.size(); ++i) {
+                    lua_pushinteger(state, value[i]);
+                    lua_rawseti(state, -2, static_cast<int>(i + 1));
+                }
+                std::vector<int> result(elsa::utility::raw_length(state, -1));
+                for(std::size_t i = 0; i < result.size(); ++i) {
+                    lua_rawgeti(state, -1, static_cast<int>(i + 1));
+                    result[i] = static_cast<int>(lua_tointeger(state, -1));
+                    lua_pop(state, 1);
+                }
+                keep(result);
+            }
+            else if constexpr(std::is_same<T, std::map<std::string, int>>::value) {
+                lua_createtable(state, 0, static_cast<int>(value.size()));
+                for(const auto& entry: value) {
+                    lua_pushlstring(state, entry.first.data(), entry.first.size());
+                    lua_pushinteger(state, entry.second);
+                    lua_rawset(state, -3);
+                }
+                std::map<std::string, int> result;
+                lua_pushnil(state);
+                while(lua_next(state, -2)) {
+                    std::size_t length = 0;
+                    const char* key = lua_tolstring(state, -2, &length);
+                    result.emplace(std::string(key, length), static_cast<int>(lua_tointeger(state, -1)));
+                    lua_pop(state, 1);
+                }
+                keep(result);
+            }
+            else if constexpr(std::is_same<T, particle>::value) {
+                lua_createtable(state, 0, 4);
+                lua_pushnumber(state, value.x);
+                lua_setfield(state, -2, "x");
+                lua_pushnumber(state, value.y);
+                lua_setfield(state, -2, "y");
+                lua_pushnumber(state, value.z);
+                lua_setfield(state, -2, "z");
+                lua_pushinteger(state, value.id);
+                lua_setfield(state, -2, "id");
+                particle result;
+                lua_getfield(state, -1, "x");
+                result.x = lua_tonumber(state, -1);
+                lua_getfield(state, -2, "y");
+                result.y = lua_tonumber(state, -1);
+                lua_getfield(state, -3, "z");
+                result.z = lua_tonumber(state, -1);
+                lua_getfield(state, -4, "id");
+                result.id = static_cast<int>(lua_tointeger(state, -1));
+                lua_pop(state, 4);
+                keep(result);
+            }
+            lua_pop(state, 1);
+        }
+    };
+}
+
+static std::vector<benchmark> benchmarks() {
+    std::vector<benchmark> list {
+        lookup<1>(), lookup<2>(), lookup<3>(), lookup<4>(), lookup<5>(),
+        call(std::make_index_sequence<0>()), call(std::make_index_sequence<1>()),
+        call(std::make_index_sequence<2>()), call(std::make_index_sequence<3>()),
+        call(std::make_index_sequence<4>()), call(std::make_index_sequence<5>()),
+        call(std::make_index_sequence<6>()), call(std::make_index_sequence<7>()),
+        call(std::make_index_sequence<8>()),
+        {
+            "result_conversion",
+            [](elsa::state& state) {
+                int count = state["count"](1, 2);
+                keep(count);
+            },
+            [](lua_State* state) {
+                lua_getglobal(state, "count");
+                lua_pushinteger(state, 1);
+                lua_pushinteger(state, 2);
+                if(lua_pcall(state, 2, 1, 0)) std::abort();
+                keep(static_cast<int>(lua_tointeger(state, -1)));
+                lua_pop(state, 1);
+            }
+        },
+        push_get<int>("int", 42),
+        push_get<long>("long", 42),
+        push_get<double>("double", 4.2),
+        push_get<float>("float", 4.2f),
+        push_get<bool>("bool", true),
+        push_get<std::string>("string", "the quick brown fox jumps over the lazy dog"),
+        push_get<std::vector<int>>("vector_8", { 1, 2, 3, 4, 5, 6, 7, 8 }),
+        push_get<std::map<std::string, int>>("map_4", { { "a", 1 }, { "b", 2 }, { "c", 3 }, { "d", 4 } }),
+        push_get<particle>("struct_4", { 1.5, 2.5, 3.5, 7 }),
+        {
+            "state_call_string",
+            [](elsa::state& state) {
+                keep(state.call<int>("return 1 + 2"));
+            },
+            [](lua_State* state) {
+                if(luaL_loadstring(state, "return 1 + 2") || lua_pcall(state, 0, 1, 0)) std::abort();
+                keep(static_cast<int>(lua_tointeger(state, -1)));
+                lua_pop(state, 1);
+            }
+        },
+        {
+            "state_copy",
+            [](elsa::state& state) {
+                elsa::state copy { state };
+                keep(copy);
+            },
+            [](lua_State* state) {
+                lua_State* copy { state };
+                keep(copy);
+            }
+        },
+        {
+            "table_ipairs_1000",
+            [](elsa::state& state) {
+                long sum = 0;
+                for(const auto& item: state["list"].ipairs<long>()) sum += item.second;
+                keep(sum);
+            },
+            [](lua_State* state) {
+                long sum = 0;
+                lua_getglobal(state, "list");
+                for(int i = 1;; ++i) {
+                    lua_rawgeti(state, -1, i);
+                    if(lua_isnil(state, -1)) break;
+                    sum += static_cast<long>(lua_tointeger(state, -1));
+                    lua_pop(state, 1);
+                }
+                lua_pop(state, 2);
+                keep(sum);
+            }
+        },
+        {
+            "table_pairs_1000",
+            [](elsa::state& state) {
+                long sum = 0;
+                for(const auto& pair: state["list"].pairs<long, long>()) sum += pair.first + pair.second;
+                keep(sum);
+            },
+            [](lua_State* state) {
+                long sum = 0;
+                lua_getglobal(state, "list");
+                lua_pushnil(state);
+                while(lua_next(state, -2)) {
+                    sum += static_cast<long>(lua_tointeger(state, -2) + lua_tointeger(state, -1));
+                    lua_pop(state, 1);
+                }
+                lua_pop(state, 1);
+                keep(sum);
+            }
+        },
+        {
+            "state_move",
+            [](elsa::state& state) {
+                elsa::state copy { state };
+                elsa::state moved { std::move(copy) };
+                keep(moved);
+            },
+            [](lua_State* state) {
+                lua_State* moved { state };
+                keep(moved);
+            }
+        },
+    };
+    return list;
+}
+
+
+
+static void print_csv(const std::vector<measurement>& results) {
+    std::cout << "name,variant,iterations,ns_per_op,cpp_allocs_per_op,lua_allocs_per_op" << std::endl;
+    for(const auto& result: results) {
+        std::cout << result.name << "," << result.variant << "," << result.iterations << "," <<
+            result.ns_per_op << "," << result.cpp_allocs_per_op << "," << result.lua_allocs_per_op << std::endl;
+    }
+}
+
+static void print_json(const std::vector<measurement>& results) {
+    std::cout << "{\n  \"elsa\": \"" << elsa::version << "\",\n  \"lua\": \"" << elsa::lua_version <<
+        "\",\n  \"results\": [\n";
+    for(std::size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        std::cout << "    { \"name\": \"" << result.name << "\", \"variant\": \"" << result.variant <<
+            "\", \"iterations\": " << result.iterations << ", \"ns_per_op\": " << result.ns_per_op <<
+            ", \"cpp_allocs_per_op\": " << result.cpp_allocs_per_op <<
+            ", \"lua_allocs_per_op\": " << result.lua_allocs_per_op << " }" <<
+            (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ]\n}" << std::endl;
+}
+
+int main(int argc, const char* argv[]) {
+    bool csv = false;
+    std::string filter;
+    for(int i = 1; i < argc; ++i) {
+        if(std::strcmp(argv[i], "--csv") == 0) csv = true;
+        else if(std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else if(std::strcmp(argv[i], "--time") == 0 && i + 1 < argc) min_time = std::chrono::milliseconds(std::atoi(argv[++i]));
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--csv] [--filter <substring>] [--time <milliseconds>]" << std::endl;
+            return 1;
+        }
+    }
+
+    elsa::state state { counting_alloc, nullptr, true };
+    state(setup);
+
+    std::vector<measurement> results;
+    for(const auto& bench: benchmarks()) {
+        if(!filter.empty() && bench.name.find(filter) == std::string::npos) continue;
+        results.push_back(measure(bench.name, "elsa", [&]() { bench.elsa(state); }));
+        results.push_back(measure(bench.name, "raw", [&]() { bench.raw(state); }));
+        if(lua_gettop(state) != 0) {
+            std::cerr << bench.name << " left " << lua_gettop(state) << " values on the stack" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << std::setprecision(4);
+    if(csv) print_csv(results);
+    else print_json(results);
+    return 0;
+}
@@ -12,3 +12,8 @@
 #endif
 
 #include "elsa/State.hpp"
+#include "elsa/StatePool.hpp"
+#include "elsa/Executor.hpp"
+#include "elsa/Actor.hpp"
+#include "elsa/Thread.hpp"
+#include "elsa/Profiler.hpp"
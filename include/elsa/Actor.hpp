@@ -0,0 +1,236 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  Actor.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+
+namespace elsa {
+namespace utility {
+
+//
+// Bounded lock-free queue for many producers and a single consumer. Every cell
+// carries a sequence number telling whether it is free for the producer claiming
+// its position or holds a value for the consumer.
+//
+template<typename T>
+class mpsc_ring {
+    struct cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<cell[]> cells;
+    const std::size_t mask;
+    alignas(64) std::atomic<std::size_t> tail { 0 };
+    // only accessed by the consumer
+    alignas(64) std::size_t head { 0 };
+
+    static std::size_t power_of_two(std::size_t size) {
+        std::size_t result = 2;
+        while(result < size) result *= 2;
+        return result;
+    }
+
+public:
+
+    explicit mpsc_ring(std::size_t capacity):
+    cells(new cell[power_of_two(capacity)]), mask(power_of_two(capacity) - 1) {
+        for(std::size_t i = 0; i <= mask; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // returns false if the queue is full
+    bool try_push(T value) {
+        std::size_t position = tail.load(std::memory_order_relaxed);
+        while(true) {
+            auto& target = cells[position & mask];
+            const std::size_t sequence = target.sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+            if(difference == 0) {
+                if(tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    target.value = std::move(value);
+                    target.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(difference < 0) return false;
+            else position = tail.load(std::memory_order_relaxed);
+        }
+    }
+    // consumer only
+    bool try_pop(T& value) {
+        auto& target = cells[head & mask];
+        if(target.sequence.load(std::memory_order_acquire) != head + 1) return false;
+        value = std::move(target.value);
+        target.sequence.store(head + mask + 1, std::memory_order_release);
+        ++head;
+        return true;
+    }
+    // consumer only
+    bool empty() const {
+        return cells[head & mask].sequence.load(std::memory_order_acquire) != head + 1;
+    }
+    inline std::size_t capacity() const {
+        return mask + 1;
+    }
+};
+
+}
+
+struct actor_stats {
+    std::size_t executed { 0 };
+    // wakeups of the actor thread that ran at least one call
+    std::size_t batches { 0 };
+    // calls queued in the overflow queue because the ring buffer was full
+    std::size_t overflowed { 0 };
+};
+
+//
+// State confined to a dedicated thread. Calls from any thread are queued in a
+// lock-free ring buffer and return a future, producers never wait for the
+// interpreter. The actor thread drains the queue in batches under a single
+// stack guard and sleeps when it is empty. When the ring buffer is full, calls
+// go to an unbounded overflow queue guarded by a mutex, which is only held to
+// move calls in or out. Calls of one producer run in the order they were made.
+//
+class actor_state {
+    elsa::state state;
+    utility::selector_cache selectors { state };
+    utility::mpsc_ring<utility::task*> ring;
+    const std::size_t batch;
+
+    // while the overflow queue holds calls, new calls are queued behind them
+    std::mutex overflow_mutex {};
+    std::deque<std::unique_ptr<utility::task>> overflow {};
+    std::atomic<std::size_t> overflow_size { 0 };
+
+    std::atomic<std::size_t> executed { 0 };
+    std::atomic<std::size_t> batches { 0 };
+    std::atomic<std::size_t> overflowed { 0 };
+    std::atomic<bool> stopping { false };
+
+    std::mutex sleep_mutex {};
+    std::condition_variable wake {};
+    std::atomic<bool> sleeping { false };
+    std::thread thread {};
+
+    void run() {
+        while(true) {
+            std::size_t count = 0;
+            {
+                utility::stack_guard guard { state };
+                utility::task* next;
+                while(count < batch && ring.try_pop(next)) {
+                    std::unique_ptr<utility::task> task { next };
+                    task->run(selectors);
+                    ++count;
+                }
+                // the ring buffer is drained, the overflowing calls are next in order
+                if(count < batch && overflow_size.load() > 0) {
+                    std::deque<std::unique_ptr<utility::task>> pending;
+                    {
+                        std::lock_guard<std::mutex> lock { overflow_mutex };
+                        pending.swap(overflow);
+                        overflow_size.store(0);
+                    }
+                    for(auto& task: pending) task->run(selectors);
+                    count += pending.size();
+                }
+            }
+            if(count) {
+                executed.fetch_add(count, std::memory_order_relaxed);
+                batches.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock { sleep_mutex };
+            sleeping.store(true);
+            // pairs with the fence of enqueue, either side sees the other's store
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            wake.wait(lock, [&]() {
+                return stopping.load() || !ring.empty() || overflow_size.load() > 0;
+            });
+            sleeping.store(false);
+            if(stopping.load() && ring.empty() && overflow_size.load() == 0) return;
+        }
+    }
+
+    void enqueue(std::unique_ptr<utility::task> task) {
+        if(overflow_size.load() > 0 || !ring.try_push(task.get())) {
+            std::lock_guard<std::mutex> lock { overflow_mutex };
+            overflow.push_back(std::move(task));
+            overflow_size.store(overflow.size());
+            overflowed.fetch_add(1, std::memory_order_relaxed);
+        }
+        else task.release();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(sleeping.load(std::memory_order_relaxed)) {
+            { std::lock_guard<std::mutex> lock { sleep_mutex }; }
+            wake.notify_one();
+        }
+    }
+
+public:
+
+    //
+    // Create the state like a state_pool and start its thread. Up to @capacity calls
+    // can be queued, at most @batch of them run per wakeup.
+    //
+    explicit actor_state(bool open_libs = true, const std::string& init = {},
+        const std::function<void(elsa::state&)>& setup = {}, std::size_t capacity = 1024, std::size_t batch = 64):
+    state(open_libs), ring(capacity), batch(batch ? batch : 1) {
+        if(!init.empty()) state(init);
+        if(setup) setup(state);
+        thread = std::thread([this]() { run(); });
+    }
+    // runs all queued calls before returning
+    ~actor_state() {
+        stopping = true;
+        { std::lock_guard<std::mutex> lock { sleep_mutex }; }
+        wake.notify_one();
+        if(thread.joinable()) thread.join();
+    }
+
+    actor_state(const actor_state&) = delete;
+    actor_state& operator=(const actor_state&) = delete;
+
+    //
+    // Call the function at the dot separated @path, returning Ret... like selector::call.
+    //
+    template<typename... Ret, typename... Arg>
+    auto ask(const std::string& path, Arg&&... args) {
+        auto task = utility::make_task<Ret...>(path, std::forward<Arg>(args)...);
+        auto future = task->promise.get_future();
+        enqueue(std::move(task));
+        return future;
+    }
+    // call the function at @path ignoring its results, the future reports completion and errors
+    template<typename... Arg>
+    std::future<void> post(const std::string& path, Arg&&... args) {
+        return ask<>(path, std::forward<Arg>(args)...);
+    }
+
+    actor_stats stats() const {
+        return { executed.load(), batches.load(), overflowed.load() };
+    }
+    inline std::size_t capacity() const {
+        return ring.capacity();
+    }
+
+};
+
+}
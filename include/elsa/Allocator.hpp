@@ -0,0 +1,244 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  Allocator.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+
+namespace elsa {
+
+struct memory_stats {
+    std::size_t live { 0 };
+    std::size_t peak { 0 };
+    std::size_t limit { 0 };
+    std::size_t allocations { 0 };
+    std::size_t frees { 0 };
+    std::size_t failures { 0 };
+};
+
+//
+// Memory policy of a state. A @limit of 0 disables the hard cap, @pooled serves
+// small blocks from thread-local size-class caches instead of malloc.
+//
+struct allocator_policy {
+    std::size_t limit { 0 };
+    bool pooled { true };
+};
+
+namespace utility {
+
+//
+// Per-thread free lists of small blocks, one list per 16 byte size class.
+// Blocks are malloc-backed and may be freed on a different thread than they were
+// allocated on, each list keeps at most @capacity blocks.
+//
+class block_cache {
+public:
+    static constexpr std::size_t granularity { 16 };
+    static constexpr std::size_t classes { 16 };
+    static constexpr std::size_t max_size { granularity * classes };
+    static constexpr std::size_t capacity { 512 };
+
+private:
+    struct node {
+        node* next;
+    };
+    node* heads[classes] {};
+    std::size_t counts[classes] {};
+
+    struct holder;
+
+public:
+
+    static inline std::size_t size_class(std::size_t size) {
+        return (size - 1) / granularity;
+    }
+
+    // the cache of the calling thread or nullptr while the thread exits
+    static block_cache* local();
+
+    void* allocate(std::size_t index) {
+        if(node* block = heads[index]) {
+            heads[index] = block->next;
+            --counts[index];
+            return block;
+        }
+        return std::malloc((index + 1) * granularity);
+    }
+    void deallocate(void* block, std::size_t index) {
+        if(counts[index] >= capacity) {
+            std::free(block);
+            return;
+        }
+        auto entry = static_cast<node*>(block);
+        entry->next = heads[index];
+        heads[index] = entry;
+        ++counts[index];
+    }
+
+    void clear() {
+        for(std::size_t index = 0; index < classes; ++index) {
+            while(node* block = heads[index]) {
+                heads[index] = block->next;
+                std::free(block);
+            }
+            counts[index] = 0;
+        }
+    }
+};
+
+struct block_cache::holder {
+    block_cache cache {};
+    bool& destroyed;
+    ~holder() {
+        cache.clear();
+        destroyed = true;
+    }
+};
+inline block_cache* block_cache::local() {
+    thread_local bool destroyed { false };
+    if(destroyed) return nullptr;
+    thread_local holder value { {}, destroyed };
+    return &value.cache;
+}
+
+//
+// lua_Alloc backend of states created with an allocator_policy. The arena is owned
+// by the Lua state and deleted after lua_close by the last owning base_state.
+// Its counters are only touched by the thread currently running the state.
+//
+class arena {
+    memory_stats counters {};
+    bool pooled;
+
+    static inline bool small(std::size_t size) {
+        return size <= block_cache::max_size;
+    }
+
+    void* acquire(std::size_t size) {
+        if(pooled && small(size)) {
+            if(auto cache = block_cache::local()) return cache->allocate(block_cache::size_class(size));
+            return std::malloc((block_cache::size_class(size) + 1) * block_cache::granularity);
+        }
+        return std::malloc(size);
+    }
+    void release(void* block, std::size_t size) {
+        if(pooled && small(size)) {
+            if(auto cache = block_cache::local()) return cache->deallocate(block, block_cache::size_class(size));
+        }
+        std::free(block);
+    }
+
+    //
+    // Lua up to 5.3 assumes shrinking never fails, a block that can not be moved
+    // is kept instead. Every block is malloc-backed and at least @nsize bytes large,
+    // so it may later be released under the size class of @nsize.
+    //
+    void* reallocate(void* block, std::size_t osize, std::size_t nsize) {
+        if(!block) return acquire(nsize);
+        if(!pooled || (!small(osize) && !small(nsize))) {
+            void* resized = std::realloc(block, nsize);
+            return resized || nsize > osize ? resized : block;
+        }
+        if(small(osize) && small(nsize) && block_cache::size_class(osize) == block_cache::size_class(nsize)) {
+            return block;
+        }
+        void* moved = acquire(nsize);
+        if(!moved) return nsize > osize ? nullptr : block;
+        std::memcpy(moved, block, std::min(osize, nsize));
+        release(block, osize);
+        return moved;
+    }
+
+public:
+
+    explicit arena(const allocator_policy& policy):
+    pooled(policy.pooled) {
+        counters.limit = policy.limit;
+    }
+
+    static void* allocate(void* ud, void* block, std::size_t osize, std::size_t nsize) {
+        auto& self = *static_cast<arena*>(ud);
+        // for new blocks osize encodes the type of the object
+        if(!block) osize = 0;
+        if(nsize == 0) {
+            if(block) {
+                self.release(block, osize);
+                self.counters.live -= osize;
+                ++self.counters.frees;
+            }
+            return nullptr;
+        }
+        auto& counters = self.counters;
+        if(counters.limit && nsize > osize && counters.live - osize + nsize > counters.limit) {
+            ++counters.failures;
+            return nullptr;
+        }
+        void* result = self.reallocate(block, osize, nsize);
+        if(!result) {
+            ++counters.failures;
+            return nullptr;
+        }
+        if(!block) ++counters.allocations;
+        counters.live = counters.live - osize + nsize;
+        counters.peak = std::max(counters.peak, counters.live);
+        return result;
+    }
+
+    inline const memory_stats& stats() const {
+        return counters;
+    }
+    inline void set_limit(std::size_t limit) {
+        counters.limit = limit;
+    }
+};
+
+// the arena of @state or nullptr if it uses another allocator
+inline arena* find_arena(lua_State* state) {
+    void* ud = nullptr;
+    if(lua_getallocf(state, &ud) != &arena::allocate) return nullptr;
+    return static_cast<arena*>(ud);
+}
+
+inline int panic(lua_State* state) {
+    const char* message = lua_tostring(state, -1);
+    std::fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", message ? message : "error object is not a string");
+    return 0;
+}
+
+//
+// Create a Lua state allocating through a new arena. Returns nullptr on failure,
+// LuaJIT builds without support for custom allocators always fail.
+//
+inline lua_State* new_state(const allocator_policy& policy) {
+    auto memory = new arena(policy);
+    lua_State* state = lua_newstate(&arena::allocate, memory);
+    if(!state) {
+        delete memory;
+        return nullptr;
+    }
+    lua_atpanic(state, panic);
+    return state;
+}
+
+// close @state and delete its arena
+inline void close_state(lua_State* state) {
+    auto memory = find_arena(state);
+    lua_close(state);
+    delete memory;
+}
+
+}
+}
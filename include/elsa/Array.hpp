@@ -0,0 +1,169 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  Array.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+
+
+namespace elsa {
+namespace utility {
+
+//
+// Bulk transfer of numeric buffers to and from the array part of Lua tables.
+//
+
+namespace detail {
+    template<typename T>
+    inline void push_number(lua_State* state, const T value) {
+        if constexpr(std::is_integral<T>::value) lua_pushinteger(state, static_cast<lua_Integer>(value));
+        else lua_pushnumber(state, static_cast<lua_Number>(value));
+    }
+    //
+    // Floats read into integral types are truncated, lua_tointeger would return 0
+    // for them on Lua 5.3 and later. Integers are still read as integers so 64 bit
+    // values keep their precision.
+    //
+    template<typename T>
+    inline T to_number(lua_State* state, const int index) {
+#if LUA_VERSION_NUM >= 503
+        if constexpr(std::is_integral<T>::value) {
+            if(lua_isinteger(state, index)) return static_cast<T>(lua_tointeger(state, index));
+        }
+#endif
+        return static_cast<T>(lua_tonumber(state, index));
+    }
+}
+
+//
+// Overwrite t[1..size] of the table at @index with @data and clear any
+// elements after it so the length of the table becomes @size.
+//
+template<typename T>
+inline void fill_array(lua_State* state, int index, const T* data, const std::size_t size) {
+    static_assert(std::is_arithmetic<T>::value, "Only arithmetic types can be transferred in bulk");
+    index = absolute_index(state, index);
+    check_stack(state, 1);
+    const int length = static_cast<int>(size);
+    for(int i = 0; i < length; ++i) {
+        detail::push_number(state, data[i]);
+        lua_rawseti(state, index, i + 1);
+    }
+    for(int i = static_cast<int>(raw_length(state, index)); i > length; --i) {
+        lua_pushnil(state);
+        lua_rawseti(state, index, i);
+    }
+}
+
+//
+// Push a new table holding @size elements of @data in its array part.
+//
+template<typename T>
+inline void push_array(lua_State* state, const T* data, const std::size_t size) {
+    check_stack(state, 2);
+    lua_createtable(state, static_cast<int>(size), 0);
+    fill_array(state, -1, data, size);
+}
+
+//
+// Read up to @size elements of the array part of the table at @index into @out.
+// Returns the number of elements read.
+//
+template<typename T>
+inline std::size_t read_array(lua_State* state, int index, T* out, const std::size_t size) {
+    static_assert(std::is_arithmetic<T>::value, "Only arithmetic types can be transferred in bulk");
+    if(!lua_istable(state, index)) return 0;
+    index = absolute_index(state, index);
+    check_stack(state, 1);
+    const int length = static_cast<int>(std::min(size, raw_length(state, index)));
+    for(int i = 0; i < length; ++i) {
+        lua_rawgeti(state, index, i + 1);
+        out[i] = detail::to_number<T>(state, -1);
+        lua_pop(state, 1);
+    }
+    return static_cast<std::size_t>(length);
+}
+
+//
+// Overloads for contiguous containers such as std::vector, std::array and std::span.
+//
+template<typename C, typename = decltype(std::data(std::declval<C&>()))>
+inline void push_array(lua_State* state, const C& values) {
+    push_array(state, std::data(values), std::size(values));
+}
+template<typename C, typename = decltype(std::data(std::declval<C&>()))>
+inline void fill_array(lua_State* state, int index, const C& values) {
+    fill_array(state, index, std::data(values), std::size(values));
+}
+template<typename C, typename = decltype(std::data(std::declval<C&>()))>
+inline std::size_t read_array(lua_State* state, int index, C&& values) {
+    return read_array(state, index, std::data(values), std::size(values));
+}
+
+
+#if defined(LUAJIT_VERSION)
+
+//
+// Expose a buffer to Lua as an FFI cdata pointer without copying it.
+// The caller must keep the buffer alive while Lua code can access the pointer.
+//
+
+template<typename T> struct ctype_name;
+template<> struct ctype_name<double> { static constexpr const char* value { "double*" }; };
+template<> struct ctype_name<float> { static constexpr const char* value { "float*" }; };
+template<> struct ctype_name<std::int8_t> { static constexpr const char* value { "int8_t*" }; };
+template<> struct ctype_name<std::uint8_t> { static constexpr const char* value { "uint8_t*" }; };
+template<> struct ctype_name<std::int16_t> { static constexpr const char* value { "int16_t*" }; };
+template<> struct ctype_name<std::uint16_t> { static constexpr const char* value { "uint16_t*" }; };
+template<> struct ctype_name<std::int32_t> { static constexpr const char* value { "int32_t*" }; };
+template<> struct ctype_name<std::uint32_t> { static constexpr const char* value { "uint32_t*" }; };
+template<> struct ctype_name<std::int64_t> { static constexpr const char* value { "int64_t*" }; };
+template<> struct ctype_name<std::uint64_t> { static constexpr const char* value { "uint64_t*" }; };
+
+struct ffi_cast {
+    int ref { LUA_NOREF };
+};
+
+template<typename T>
+inline void push_cdata(lua_State* state, T* data) {
+    auto& cast = registry_object<ffi_cast>(state);
+    check_stack(state, 3);
+    if(cast.ref == LUA_NOREF) {
+        const char* code {
+            "local ffi = require('ffi'); local types = {}; "
+            "return function(name, pointer) "
+            "local ctype = types[name]; "
+            "if not ctype then ctype = ffi.typeof(name); types[name] = ctype; end; "
+            "return ffi.cast(ctype, pointer); end"
+        };
+        if(luaL_loadstring(state, code) || lua_pcall(state, 0, 1, 0)) {
+            std::string error = lua_tostring(state, -1);
+            lua_pop(state, 1);
+            throw std::runtime_error("Could not load the FFI library: " + error);
+        }
+        cast.ref = luaL_ref(state, LUA_REGISTRYINDEX);
+    }
+    lua_rawgeti(state, LUA_REGISTRYINDEX, cast.ref);
+    lua_pushstring(state, ctype_name<std::remove_const_t<T>>::value);
+    lua_pushlightuserdata(state, const_cast<std::remove_const_t<T>*>(data));
+    if(lua_pcall(state, 2, 1, 0)) {
+        std::string error = lua_tostring(state, -1);
+        lua_pop(state, 1);
+        throw std::runtime_error("Could not create cdata: " + error);
+    }
+}
+
+#endif
+
+}
+}
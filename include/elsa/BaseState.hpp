@@ -15,30 +15,67 @@
 
 
 namespace elsa {
+namespace utility {
+
+//
+// Shared by all owning instances of a state. With ELSA_SINGLE_THREADED defined the
+// counter is a plain integer, states must then not be shared between threads.
+//
+struct state_control {
+    lua_State* state;
+#if defined(ELSA_SINGLE_THREADED)
+    unsigned int references { 1 };
+
+    inline void acquire() {
+        ++references;
+    }
+    inline bool release() {
+        return --references == 0;
+    }
+    inline unsigned int count() const {
+        return references;
+    }
+#else
+    std::atomic<unsigned int> references { 1 };
+
+    inline void acquire() {
+        references.fetch_add(1u, std::memory_order_relaxed);
+    }
+    inline bool release() {
+        if(references.fetch_sub(1u, std::memory_order_release) != 1u) return false;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+    inline unsigned int count() const {
+        return references.load(std::memory_order_relaxed);
+    }
+#endif
+};
+
+}
 
 class base_state {
 protected:
     
     lua_State* lstate;
     
-    bool ownership;
-    std::atomic<unsigned int>* refcount { new std::atomic<unsigned int> { 0 }};
+    // nullptr for states not owning their lua_State
+    utility::state_control* control { nullptr };
     
 public:
     
     base_state(lua_State* lstate, bool take_ownership):
-        lstate(lstate), ownership(take_ownership) {
-        std::atomic_fetch_add_explicit(refcount, 1u, std::memory_order_relaxed);
+        lstate(lstate) {
+        if(take_ownership && lstate) control = new utility::state_control { lstate };
     };
     base_state(const base_state& rhs):
-    lstate(rhs.lstate), ownership(rhs.ownership), refcount(rhs.refcount) {
-        std::atomic_fetch_add_explicit(refcount, 1u, std::memory_order_relaxed);
+    lstate(rhs.lstate), control(rhs.control) {
+        if(control) control->acquire();
     }
     base_state(base_state&& rhs):
-    lstate(rhs.lstate), ownership(rhs.ownership), refcount(rhs.refcount) {
+    lstate(rhs.lstate), control(rhs.control) {
         rhs.lstate = nullptr;
-        rhs.ownership = false;
-        rhs.refcount = nullptr;
+        rhs.control = nullptr;
     }
     // copy&swap assignment
     base_state& operator=(base_state rhs) {
@@ -47,17 +84,18 @@ public:
     }
     
     ~base_state() {
-        if(!lstate) return;
-        if(std::atomic_fetch_sub_explicit(refcount, 1u, std::memory_order_release) == 1u && ownership) {
-            std::atomic_thread_fence(std::memory_order_acquire);
-            delete refcount;
-            lua_close(lstate);
+        if(control && control->release()) {
+            utility::close_state(control->state);
+            delete control;
         }
     }
     
+    // number of owning instances, 0 for non-owning ones
     inline const unsigned int references() const {
-        if(refcount == nullptr) return 0;
-        return std::atomic_load_explicit(refcount, std::memory_order_relaxed);
+        return control ? control->count() : 0;
+    }
+    inline bool owning() const {
+        return control != nullptr;
     }
     
     inline operator lua_State*const() const {
@@ -69,8 +107,7 @@ public:
     }
     
     friend void swap(base_state& lhs, base_state& rhs) noexcept {
-        std::swap(lhs.refcount, rhs.refcount);
-        std::swap(lhs.ownership, rhs.ownership);
+        std::swap(lhs.control, rhs.control);
         std::swap(lhs.lstate, rhs.lstate);
     }
     
@@ -87,7 +124,7 @@ public:
         return lhs == rhs.lstate;
     }
     inline friend bool operator!=(const base_state& lhs, lua_State* rhs) {
-        return lhs.lstate == rhs;
+        return lhs.lstate != rhs;
     }
     inline friend bool operator!=(lua_State* lhs, const base_state& rhs) {
         return lhs != rhs.lstate;
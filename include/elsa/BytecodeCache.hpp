@@ -0,0 +1,192 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  BytecodeCache.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+
+
+namespace elsa {
+
+struct bytecode_stats {
+    std::size_t hits { 0 };
+    std::size_t misses { 0 };
+    std::size_t stale { 0 };
+    std::size_t writes { 0 };
+};
+
+namespace utility {
+
+// FNV-1a, stable across processes unlike std::hash
+inline std::uint64_t content_hash(const char* data, std::size_t size) {
+    std::uint64_t hash { 14695981039346656037ull };
+    for(std::size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline int dump_writer(lua_State*, const void* data, std::size_t size, void* buffer) {
+    static_cast<std::string*>(buffer)->append(static_cast<const char*>(data), size);
+    return 0;
+}
+
+// dump the function on top of the stack into @buffer, keeping debug information
+inline bool dump(lua_State* state, std::string& buffer) {
+#if LUA_VERSION_NUM >= 503
+    return lua_dump(state, dump_writer, &buffer, 0) == 0;
+#else
+    return lua_dump(state, dump_writer, &buffer) == 0;
+#endif
+}
+
+}
+
+//
+// Compiled chunks of script files stored on disk, next to the sources or in a
+// cache directory. Entries record the Lua version, path, modification time, size
+// and content hash of their source and are ignored when any of them changed.
+//
+class bytecode_cache {
+
+    static constexpr char magic[8] { 'E', 'L', 'S', 'A', 'B', 'C', '1', '\0' };
+
+    std::string directory {};
+    bool enabled_ { false };
+    bytecode_stats stats_ {};
+
+    struct source_info {
+        std::int64_t mtime;
+        std::uint64_t size;
+        std::uint64_t hash;
+    };
+
+    std::string entry_path(const std::string& file) const {
+        if(directory.empty()) return file + "c";
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx",
+            static_cast<unsigned long long>(utility::content_hash(file.data(), file.size())));
+        return (std::filesystem::path(directory) / (std::string(name) + ".luac")).string();
+    }
+
+    static std::string header(const std::string& file, const source_info& info) {
+        std::string header { magic, sizeof(magic) };
+        const std::string version { lua_version + "/" + std::to_string(lua_version_num) +
+            "/" + std::to_string(sizeof(void*)) };
+        auto append = [&](const void* data, std::size_t size) {
+            header.append(static_cast<const char*>(data), size);
+        };
+        const std::uint32_t version_size = static_cast<std::uint32_t>(version.size());
+        const std::uint32_t path_size = static_cast<std::uint32_t>(file.size());
+        append(&version_size, sizeof(version_size));
+        header += version;
+        append(&path_size, sizeof(path_size));
+        header += file;
+        append(&info.mtime, sizeof(info.mtime));
+        append(&info.size, sizeof(info.size));
+        append(&info.hash, sizeof(info.hash));
+        return header;
+    }
+
+    void write(const std::string& path, const std::string& header, const std::string& bytecode) {
+        std::error_code error;
+        const auto target = std::filesystem::path(path);
+        if(target.has_parent_path()) std::filesystem::create_directories(target.parent_path(), error);
+        // write to a unique temporary file and rename it so readers never see partial entries
+        static std::atomic<unsigned> counter { 0 };
+        const std::string temporary { path + "." +
+            std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + "." +
+            std::to_string(counter++) + ".tmp" };
+        {
+            std::ofstream stream { temporary, std::ios::binary | std::ios::trunc };
+            if(!stream) return;
+            stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+            stream.write(bytecode.data(), static_cast<std::streamsize>(bytecode.size()));
+            if(!stream) {
+                stream.close();
+                std::filesystem::remove(temporary, error);
+                return;
+            }
+        }
+        std::filesystem::rename(temporary, path, error);
+        if(error) std::filesystem::remove(temporary, error);
+        else ++stats_.writes;
+    }
+
+public:
+
+    inline bool enabled() const {
+        return enabled_;
+    }
+    inline bytecode_stats stats() const {
+        return stats_;
+    }
+
+    //
+    // Store entries in @directory, or next to their source file as "<file>c" if empty.
+    //
+    void enable(std::string directory) {
+        this->directory = std::move(directory);
+        enabled_ = true;
+    }
+    void disable() {
+        enabled_ = false;
+    }
+
+    //
+    // Push the compiled chunk of @file, loading it from the cache if the entry is
+    // up to date and compiling and storing it otherwise.
+    // Returns the status of luaL_loadfile; on failure the error message is pushed instead.
+    //
+    int load(lua_State* state, const std::string& file) {
+        std::error_code error;
+        const auto mtime = std::filesystem::last_write_time(file, error);
+        std::string source;
+        if(error || !utility::read_file(file, source)) return luaL_loadfile(state, file.c_str());
+        const source_info info {
+            static_cast<std::int64_t>(mtime.time_since_epoch().count()),
+            static_cast<std::uint64_t>(source.size()),
+            utility::content_hash(source.data(), source.size())
+        };
+        const std::string chunkname { "@" + file };
+        const std::string path { entry_path(file) };
+        const std::string expected { header(file, info) };
+
+        std::string entry;
+        if(utility::read_file(path, entry)) {
+            if(entry.size() > expected.size() && entry.compare(0, expected.size(), expected) == 0) {
+                const int status = luaL_loadbuffer(state, entry.data() + expected.size(),
+                    entry.size() - expected.size(), chunkname.c_str());
+                if(status == 0) {
+                    ++stats_.hits;
+                    return 0;
+                }
+                lua_pop(state, 1);
+            }
+            ++stats_.stale;
+        }
+        ++stats_.misses;
+
+        const int status = utility::load_buffer(state, source.data(), source.size(), chunkname);
+        if(status != 0) return status;
+        std::string bytecode;
+        if(utility::dump(state, bytecode)) write(path, expected, bytecode);
+        return 0;
+    }
+
+};
+
+}
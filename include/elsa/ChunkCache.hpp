@@ -0,0 +1,104 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  ChunkCache.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <list>
+#include <unordered_map>
+
+
+
+namespace elsa {
+
+struct cache_stats {
+    std::size_t hits { 0 };
+    std::size_t misses { 0 };
+    std::size_t evictions { 0 };
+    std::size_t size { 0 };
+    std::size_t capacity { 0 };
+};
+
+//
+// LRU cache of compiled chunks keyed by a hash of their source text.
+// The compiled functions are kept alive through registry references.
+//
+class chunk_cache {
+    struct entry {
+        std::size_t hash;
+        std::string source;
+        int ref;
+    };
+
+    // most recently used entries first
+    std::list<entry> entries {};
+    std::unordered_map<std::size_t, std::list<entry>::iterator> index {};
+    cache_stats stats_ {};
+
+    void evict(lua_State* state) {
+        auto& last = entries.back();
+        luaL_unref(state, LUA_REGISTRYINDEX, last.ref);
+        index.erase(last.hash);
+        entries.pop_back();
+        ++stats_.evictions;
+    }
+
+public:
+
+    inline bool enabled() const {
+        return stats_.capacity > 0;
+    }
+    inline cache_stats stats() const {
+        cache_stats stats { stats_ };
+        stats.size = entries.size();
+        return stats;
+    }
+
+    void resize(lua_State* state, std::size_t capacity) {
+        stats_.capacity = capacity;
+        while(entries.size() > capacity) evict(state);
+    }
+    void clear(lua_State* state) {
+        for(auto& entry: entries) luaL_unref(state, LUA_REGISTRYINDEX, entry.ref);
+        entries.clear();
+        index.clear();
+    }
+
+    //
+    // Push the compiled chunk for @code onto the stack, compiling and caching it on a miss.
+    // Returns the status of luaL_loadstring; on failure the error message is pushed instead.
+    //
+    int load(lua_State* state, const std::string& code) {
+        const std::size_t hash { std::hash<std::string>{}(code) };
+        auto found = index.find(hash);
+        if(found != index.end() && found->second->source == code) {
+            ++stats_.hits;
+            entries.splice(entries.begin(), entries, found->second);
+            lua_rawgeti(state, LUA_REGISTRYINDEX, found->second->ref);
+            return 0;
+        }
+        ++stats_.misses;
+        int status = luaL_loadstring(state, code.c_str());
+        if(status != 0) return status;
+        if(found != index.end()) {
+            // hash collision: replace the previous entry
+            luaL_unref(state, LUA_REGISTRYINDEX, found->second->ref);
+            entries.erase(found->second);
+            index.erase(found);
+        }
+        lua_pushvalue(state, -1);
+        entries.push_front({ hash, code, luaL_ref(state, LUA_REGISTRYINDEX) });
+        index.emplace(hash, entries.begin());
+        if(entries.size() > stats_.capacity) evict(state);
+        return 0;
+    }
+
+};
+
+}
@@ -0,0 +1,284 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  Executor.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+
+
+namespace elsa {
+namespace utility {
+
+//
+// Bound selectors of a state, keyed by their dot separated path.
+//
+class selector_cache {
+    elsa::state& state;
+    std::unordered_map<std::string, selector> selectors {};
+public:
+    explicit selector_cache(elsa::state& state):
+    state(state) {}
+
+    selector& operator[](const std::string& path) {
+        auto found = selectors.find(path);
+        if(found != selectors.end()) return found->second;
+        auto sel = state.select(path, '.');
+        sel.bind();
+        return selectors.emplace(path, std::move(sel)).first->second;
+    }
+};
+
+//
+// Type-erased call of a Lua function run on behalf of another thread.
+//
+struct task {
+    virtual ~task() = default;
+    virtual void run(selector_cache& selectors) = 0;
+};
+
+template<typename R, typename F>
+struct selector_task: task {
+    std::string path;
+    F call;
+    std::promise<R> promise {};
+
+    selector_task(std::string path, F call):
+    path(std::move(path)), call(std::move(call)) {}
+
+    void run(selector_cache& selectors) override {
+        try {
+            if constexpr(std::is_void<R>::value) {
+                call(selectors[path]);
+                promise.set_value();
+            }
+            else promise.set_value(call(selectors[path]));
+        }
+        catch(...) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+};
+
+//
+// Create the task calling @path with @args, returning Ret... like selector::call.
+//
+template<typename... Ret, typename... Arg>
+inline auto make_task(const std::string& path, Arg&&... args) {
+    using result = decltype(std::declval<selector&>().call<Ret...>(std::declval<std::decay_t<Arg>&>()...));
+    auto call = [args = std::make_tuple(std::forward<Arg>(args)...)](selector& sel) mutable -> result {
+        return std::apply([&](auto&... args) -> result {
+            return sel.call<Ret...>(args...);
+        }, args);
+    };
+    return std::make_unique<selector_task<result, decltype(call)>>(path, std::move(call));
+}
+
+}
+
+struct executor_stats {
+    std::size_t workers { 0 };
+    std::size_t executed { 0 };
+    std::size_t stolen { 0 };
+};
+
+//
+// Work-stealing scheduler over worker threads that each own one state.
+// Calls are queued on a worker and idle workers steal queued calls from busy ones.
+// Keyed calls always run on the same worker and are never stolen.
+//
+class executor {
+
+    struct worker {
+        elsa::state state;
+        utility::selector_cache selectors { state };
+        std::mutex mutex {};
+        std::deque<std::unique_ptr<utility::task>> tasks {};
+        std::deque<std::unique_ptr<utility::task>> pinned {};
+        std::atomic<std::size_t> pinned_count { 0 };
+        std::thread thread {};
+
+        worker(bool open_libs): state(open_libs) {}
+    };
+
+    std::vector<std::unique_ptr<worker>> workers {};
+    std::atomic<std::size_t> next { 0 };
+    std::atomic<std::size_t> stealable { 0 };
+    std::atomic<std::size_t> executed { 0 };
+    std::atomic<std::size_t> stolen { 0 };
+    std::atomic<bool> stopping { false };
+
+    std::mutex sleep_mutex {};
+    std::condition_variable wake {};
+    std::atomic<std::size_t> sleepers { 0 };
+
+    void notify(bool all) {
+        if(sleepers.load() == 0) return;
+        { std::lock_guard<std::mutex> lock { sleep_mutex }; }
+        if(all) wake.notify_all();
+        else wake.notify_one();
+    }
+
+    std::unique_ptr<utility::task> pop(worker& self) {
+        std::lock_guard<std::mutex> lock { self.mutex };
+        if(!self.pinned.empty()) {
+            auto task = std::move(self.pinned.front());
+            self.pinned.pop_front();
+            --self.pinned_count;
+            return task;
+        }
+        if(!self.tasks.empty()) {
+            auto task = std::move(self.tasks.back());
+            self.tasks.pop_back();
+            --stealable;
+            return task;
+        }
+        return nullptr;
+    }
+    // @contended is set if a victim was skipped because its queue was locked
+    std::unique_ptr<utility::task> steal(std::size_t self, bool& contended) {
+        for(std::size_t i = 1; i < workers.size(); ++i) {
+            auto& victim = *workers[(self + i) % workers.size()];
+            std::unique_lock<std::mutex> lock { victim.mutex, std::try_to_lock };
+            if(!lock) contended = true;
+            if(!lock || victim.tasks.empty()) continue;
+            auto task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --stealable;
+            ++stolen;
+            return task;
+        }
+        return nullptr;
+    }
+
+    void run(std::size_t index) {
+        auto& self = *workers[index];
+        while(true) {
+            bool contended = false;
+            auto task = pop(self);
+            if(!task && stealable.load() > 0) task = steal(index, contended);
+            if(task) {
+                // counted before the promise is fulfilled, callers holding a result see it in stats()
+                ++executed;
+                task->run(self.selectors);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock { sleep_mutex };
+            ++sleepers;
+            // after losing every steal to a locked queue, back off instead of spinning on stealable
+            const auto ready = [&]() {
+                return stopping.load() || self.pinned_count.load() > 0 || (!contended && stealable.load() > 0);
+            };
+            if(contended) wake.wait_for(lock, std::chrono::microseconds { 50 }, ready);
+            else wake.wait(lock, ready);
+            --sleepers;
+            if(stopping.load() && stealable.load() == 0 && self.pinned_count.load() == 0) return;
+        }
+    }
+
+    void stop() {
+        stopping = true;
+        { std::lock_guard<std::mutex> lock { sleep_mutex }; }
+        wake.notify_all();
+        for(auto& worker: workers) if(worker->thread.joinable()) worker->thread.join();
+    }
+
+    void enqueue(std::unique_ptr<utility::task> task) {
+        auto& target = *workers[next++ % workers.size()];
+        {
+            std::lock_guard<std::mutex> lock { target.mutex };
+            target.tasks.push_back(std::move(task));
+            ++stealable;
+        }
+        notify(false);
+    }
+    void enqueue(std::size_t key, std::unique_ptr<utility::task> task) {
+        auto& target = *workers[key % workers.size()];
+        {
+            std::lock_guard<std::mutex> lock { target.mutex };
+            target.pinned.push_back(std::move(task));
+            ++target.pinned_count;
+        }
+        // the pinned worker might not be the one a single notification wakes
+        notify(true);
+    }
+
+public:
+
+    //
+    // Start @threads workers, each with its own state initialized like a state_pool.
+    //
+    explicit executor(std::size_t threads = std::thread::hardware_concurrency(), bool open_libs = true,
+        const std::string& init = {}, const std::function<void(elsa::state&)>& setup = {}) {
+        if(threads == 0) threads = 1;
+        workers.reserve(threads);
+        for(std::size_t i = 0; i < threads; ++i) {
+            workers.emplace_back(new worker(open_libs));
+            if(!init.empty()) workers.back()->state(init);
+            if(setup) setup(workers.back()->state);
+        }
+        try {
+            for(std::size_t i = 0; i < threads; ++i) {
+                workers[i]->thread = std::thread([this, i]() { run(i); });
+            }
+        }
+        catch(...) {
+            // the destructor does not run, joinable threads would terminate the program
+            stop();
+            throw;
+        }
+    }
+    // runs all queued calls before returning
+    ~executor() {
+        stop();
+    }
+
+    executor(const executor&) = delete;
+    executor& operator=(const executor&) = delete;
+
+    //
+    // Call the function at the dot separated @path on any worker.
+    //
+    template<typename... Ret, typename... Arg>
+    auto submit(const std::string& path, Arg&&... args) {
+        auto task = utility::make_task<Ret...>(path, std::forward<Arg>(args)...);
+        auto future = task->promise.get_future();
+        enqueue(std::move(task));
+        return future;
+    }
+    //
+    // Call the function at @path on the worker selected by @key.
+    // Calls with the same key run on the same worker in submission order.
+    //
+    template<typename... Ret, typename... Arg>
+    auto submit_keyed(std::size_t key, const std::string& path, Arg&&... args) {
+        auto task = utility::make_task<Ret...>(path, std::forward<Arg>(args)...);
+        auto future = task->promise.get_future();
+        enqueue(key, std::move(task));
+        return future;
+    }
+
+    inline std::size_t size() const {
+        return workers.size();
+    }
+    executor_stats stats() const {
+        return { workers.size(), executed.load(), stolen.load() };
+    }
+
+};
+
+}
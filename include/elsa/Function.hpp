@@ -0,0 +1,176 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  Function.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+
+
+namespace elsa {
+namespace utility {
+
+//
+// Signature of free functions, function pointers and non-generic function objects.
+//
+
+template<typename F, typename = void>
+struct function_traits {
+    static constexpr bool value { false };
+};
+template<typename R, typename... A>
+struct function_traits<R(*)(A...)> {
+    static constexpr bool value { true };
+    using result = R;
+    using arguments = std::tuple<A...>;
+};
+template<typename R, typename... A>
+struct function_traits<R(*)(A...) noexcept>: function_traits<R(*)(A...)> {};
+template<typename C, typename R, typename... A>
+struct function_traits<R(C::*)(A...)>: function_traits<R(*)(A...)> {};
+template<typename C, typename R, typename... A>
+struct function_traits<R(C::*)(A...) const>: function_traits<R(*)(A...)> {};
+template<typename C, typename R, typename... A>
+struct function_traits<R(C::*)(A...) noexcept>: function_traits<R(*)(A...)> {};
+template<typename C, typename R, typename... A>
+struct function_traits<R(C::*)(A...) const noexcept>: function_traits<R(*)(A...)> {};
+template<typename F>
+struct function_traits<F, std::void_t<decltype(&F::operator())>>: function_traits<decltype(&F::operator())> {};
+
+template<typename F>
+struct is_function: std::integral_constant<bool, function_traits<std::decay_t<F>>::value &&
+    !std::is_member_function_pointer<std::decay_t<F>>::value> {};
+
+// arguments are read by value from the stack, references only bind to usertypes
+template<typename A, typename = void>
+struct argument {
+    using type = std::decay_t<A>;
+};
+template<typename A>
+using argument_t = typename argument<A>::type;
+
+
+// userdata memory is aligned for the largest of these types
+union userdata_alignment {
+    lua_Number n;
+    double d;
+    void* p;
+    lua_Integer i;
+    long l;
+};
+
+//
+// Push the metatable for userdata holding a T, running its destructor on collection.
+// The metatable is created once per state and cached in the registry.
+//
+template<typename T>
+struct destructor_key {
+    static constexpr char key {};
+};
+template<typename T>
+inline void push_destructor_metatable(lua_State* state) {
+    lua_pushlightuserdata(state, (void*)&destructor_key<T>::key);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    if(lua_istable(state, -1)) return;
+    lua_pop(state, 1);
+    lua_createtable(state, 0, 1);
+    lua_pushcfunction(state, [](lua_State* state) -> int {
+        static_cast<T*>(lua_touserdata(state, 1))->~T();
+        return 0;
+    });
+    lua_setfield(state, -2, "__gc");
+    lua_pushlightuserdata(state, (void*)&destructor_key<T>::key);
+    lua_pushvalue(state, -2);
+    lua_rawset(state, LUA_REGISTRYINDEX);
+}
+
+
+namespace detail {
+    template<typename F, typename R, typename... A, std::size_t... N>
+    inline int invoke(lua_State* state, F& function, std::tuple<A...>*, std::index_sequence<N...>) {
+        if constexpr(std::is_void<R>::value) {
+            function(detail::get<argument_t<A>>(state, static_cast<int>(N) + 1)...);
+            return 0;
+        }
+        else {
+            push(state, function(detail::get<argument_t<A>>(state, static_cast<int>(N) + 1)...));
+            return static_cast<int>(arity<R>::value);
+        }
+    }
+    template<typename F>
+    inline int invoke(lua_State* state, F& function) {
+        using traits = function_traits<F>;
+        using arguments = typename traits::arguments;
+        return invoke<F, typename traits::result>(state, function, static_cast<arguments*>(nullptr),
+            std::make_index_sequence<std::tuple_size<arguments>::value>());
+    }
+}
+
+//
+// Run @function from within a lua_CFunction, converting C++ exceptions to Lua errors.
+//
+template<typename F>
+inline int protect(lua_State* state, F&& function) {
+#if defined(LUAJIT_VERSION) && defined(DEBUG)
+    // exceptions are converted to Lua errors by utility::wrap_exceptions
+    return function();
+#else
+    try {
+        return function();
+    }
+    catch(const std::exception& e) {
+        lua_pushstring(state, e.what());
+    }
+    catch(...) {
+        lua_pushliteral(state, "caught (...)");
+    }
+    return lua_error(state);
+#endif
+}
+
+//
+// Compile-time specialized lua_CFunction calling the function object stored inline
+// in the userdata at upvalue 1. Arguments are read straight from the stack and
+// results are pushed with the regular push overloads.
+//
+template<typename F>
+int trampoline(lua_State* state) {
+    auto& function = *static_cast<F*>(lua_touserdata(state, lua_upvalueindex(1)));
+    return protect(state, [&]() {
+        return detail::invoke(state, function);
+    });
+}
+
+//
+// Push a function pointer or function object as a Lua function.
+// Function objects are moved into a userdata upvalue, no other allocation takes place.
+//
+template<typename F>
+inline void push_function(lua_State* state, F&& function) {
+    using type = std::decay_t<F>;
+    static_assert(is_function<type>::value, "Only functions and non-generic function objects can be pushed");
+    static_assert(alignof(type) <= alignof(userdata_alignment), "Function object is overaligned");
+    check_stack(state, 2);
+    new(lua_newuserdata(state, sizeof(type))) type(std::forward<F>(function));
+    if constexpr(!std::is_trivially_destructible<type>::value) {
+        push_destructor_metatable<type>(state);
+        lua_setmetatable(state, -2);
+    }
+    lua_pushcclosure(state, &trampoline<type>, 1);
+}
+
+inline void push(lua_State* state, lua_CFunction function) {
+    lua_pushcfunction(state, function);
+}
+template<typename R, typename... A>
+inline void push(lua_State* state, R(*function)(A...)) {
+    push_function(state, function);
+}
+
+}
+}
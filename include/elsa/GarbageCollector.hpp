@@ -0,0 +1,170 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  GarbageCollector.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+
+
+namespace elsa {
+
+struct gc_stats {
+    // steps run through elsa::gc and collection cycles they completed
+    std::uint64_t steps { 0 };
+    std::uint64_t cycles { 0 };
+    // bytes freed by those steps
+    std::uint64_t collected { 0 };
+    // total and longest step time in nanoseconds
+    std::uint64_t step_time { 0 };
+    std::uint64_t max_step_time { 0 };
+    // bytes in use now and right after the last completed cycle
+    std::size_t count { 0 };
+    std::size_t baseline { 0 };
+};
+
+namespace utility {
+
+struct gc_counters {
+    gc_stats stats {};
+    // Lua 5.1 cannot report whether the collector is running
+    bool stopped { false };
+};
+
+inline std::size_t gc_count(lua_State* state) {
+    return static_cast<std::size_t>(lua_gc(state, LUA_GCCOUNT, 0)) * 1024 +
+        static_cast<std::size_t>(lua_gc(state, LUA_GCCOUNTB, 0));
+}
+
+}
+
+//
+// Control of the incremental collector of a state. Stopping the collector and
+// running it in budgeted steps keeps collection out of latency sensitive sections:
+//
+//     state.gc().stop();
+//     ...
+//     state.gc().step_for(std::chrono::microseconds { 500 }); // in an idle slot
+//
+// Counters are kept in the state, a gc object itself holds nothing but the lua_State*.
+//
+class gc {
+    using clock = std::chrono::steady_clock;
+
+    lua_State* state;
+
+public:
+
+    explicit gc(lua_State* state):
+    state(state) {}
+
+    // stop automatic collection, steps and full collections still run when requested
+    void stop() {
+        lua_gc(state, LUA_GCSTOP, 0);
+        utility::registry_object<utility::gc_counters>(state).stopped = true;
+    }
+    void restart() {
+        lua_gc(state, LUA_GCRESTART, 0);
+        utility::registry_object<utility::gc_counters>(state).stopped = false;
+    }
+    bool running() const {
+#if LUA_VERSION_NUM >= 502
+        return lua_gc(state, LUA_GCISRUNNING, 0) != 0;
+#else
+        auto counters = utility::find_registry_object<utility::gc_counters>(state);
+        return !counters || !counters->stopped;
+#endif
+    }
+
+    // bytes in use
+    inline std::size_t count() const {
+        return utility::gc_count(state);
+    }
+    void collect() {
+        lua_gc(state, LUA_GCCOLLECT, 0);
+    }
+
+    //
+    // Run a single step of @size kilobytes, 0 running a basic step.
+    // Returns whether the step finished a cycle.
+    //
+    bool step(int size = 0) {
+        auto& stats = utility::registry_object<utility::gc_counters>(state).stats;
+        const std::size_t before = count();
+        const auto start = clock::now();
+        const bool finished = lua_gc(state, LUA_GCSTEP, size) != 0;
+        const auto elapsed = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+        const std::size_t after = count();
+        ++stats.steps;
+        stats.step_time += elapsed;
+        stats.max_step_time = std::max(stats.max_step_time, elapsed);
+        if(after < before) stats.collected += before - after;
+        if(finished) {
+            ++stats.cycles;
+            stats.baseline = after;
+        }
+        return finished;
+    }
+
+    //
+    // Run steps of @size kilobytes until @budget is spent or a cycle finishes.
+    // The last step may exceed the budget by its own duration, so steps should be
+    // small compared to the budget. Returns whether a cycle finished, which is only
+    // reported in incremental mode.
+    //
+    template<typename Rep, typename Period>
+    bool step_for(std::chrono::duration<Rep, Period> budget, int size = 0) {
+        const auto deadline = clock::now() + std::chrono::duration_cast<clock::duration>(budget);
+        do {
+            if(step(size)) return true;
+        } while(clock::now() < deadline);
+        return false;
+    }
+
+    //
+    // Tuning of the incremental collector, each returning the previous value.
+    // @percent of pause is the memory growth waiting before a new cycle starts,
+    // @percent of the step multiplier the collection speed relative to allocation.
+    //
+    int set_pause(int percent) {
+        return lua_gc(state, LUA_GCSETPAUSE, percent);
+    }
+    int set_step_multiplier(int percent) {
+        return lua_gc(state, LUA_GCSETSTEPMUL, percent);
+    }
+
+#if LUA_VERSION_NUM >= 504
+    //
+    // Switch to generational mode, 0 keeping the current parameters.
+    // Returns whether the collector was in generational mode before.
+    //
+    bool generational(int minor_multiplier = 0, int major_multiplier = 0) {
+        return lua_gc(state, LUA_GCGEN, minor_multiplier, major_multiplier) == LUA_GCGEN;
+    }
+    // switch to incremental mode, 0 keeping the current parameters
+    bool incremental(int pause = 0, int step_multiplier = 0, int step_size = 0) {
+        return lua_gc(state, LUA_GCINC, pause, step_multiplier, step_size) == LUA_GCGEN;
+    }
+#endif
+
+    gc_stats stats() const {
+        gc_stats stats;
+        if(auto counters = utility::find_registry_object<utility::gc_counters>(state)) stats = counters->stats;
+        stats.count = count();
+        return stats;
+    }
+    void reset_stats() {
+        utility::registry_object<utility::gc_counters>(state).stats = {};
+    }
+};
+
+}
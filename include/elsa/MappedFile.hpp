@@ -0,0 +1,108 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  MappedFile.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <fstream>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ELSA_HAS_MMAP
+#endif
+
+
+
+namespace elsa {
+namespace utility {
+
+inline bool read_file(const std::string& file, std::string& content) {
+    std::ifstream stream { file, std::ios::binary };
+    if(!stream) return false;
+    stream.seekg(0, std::ios::end);
+    const auto size = stream.tellg();
+    if(size < 0) return false;
+    content.resize(static_cast<std::size_t>(size));
+    stream.seekg(0, std::ios::beg);
+    return static_cast<bool>(stream.read(&content[0], size));
+}
+
+//
+// Read-only view of a whole file, memory mapped where supported and read into
+// memory otherwise.
+//
+class mapped_file {
+    const char* bytes { nullptr };
+    std::size_t length { 0 };
+    bool mapped { false };
+    std::string buffer {};
+
+public:
+
+    explicit mapped_file(const std::string& file) {
+#if defined(ELSA_HAS_MMAP)
+        const int descriptor = ::open(file.c_str(), O_RDONLY);
+        if(descriptor < 0) throw std::runtime_error("Could not open file " + file);
+        struct stat info;
+        if(::fstat(descriptor, &info) != 0) {
+            ::close(descriptor);
+            throw std::runtime_error("Could not read file " + file);
+        }
+        length = static_cast<std::size_t>(info.st_size);
+        if(length > 0) {
+            void* address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if(address != MAP_FAILED) {
+                bytes = static_cast<const char*>(address);
+                mapped = true;
+            }
+        }
+        ::close(descriptor);
+        if(mapped || length == 0) return;
+#endif
+        if(!read_file(file, buffer)) throw std::runtime_error("Could not read file " + file);
+        bytes = buffer.data();
+        length = buffer.size();
+    }
+    ~mapped_file() {
+#if defined(ELSA_HAS_MMAP)
+        if(mapped) ::munmap(const_cast<char*>(bytes), length);
+#endif
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    inline const char* data() const {
+        return bytes;
+    }
+    inline std::size_t size() const {
+        return length;
+    }
+};
+
+//
+// Load a chunk from memory without copying it. Like luaL_loadfile a leading #! line
+// is skipped, keeping the line numbers of the following lines.
+//
+inline int load_buffer(lua_State* state, const char* data, std::size_t size, const std::string& chunkname) {
+    if(size > 0 && data[0] == '#') {
+        std::size_t end = 0;
+        while(end < size && data[end] != '\n') ++end;
+        // the newline stays part of text chunks, precompiled chunks start with ESC after it
+        if(end + 1 < size && data[end + 1] == '\033') ++end;
+        data += end;
+        size -= end;
+    }
+    return luaL_loadbuffer(state, data, size, chunkname.c_str());
+}
+
+}
+}
@@ -0,0 +1,375 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  Profiler.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+
+
+namespace elsa {
+
+struct profile_entry {
+    std::string function;
+    std::uint64_t calls { 0 };
+    // inclusive and exclusive time in nanoseconds
+    std::uint64_t total_time { 0 };
+    std::uint64_t self_time { 0 };
+    std::uint64_t samples { 0 };
+};
+
+enum class profile_order {
+    self_time,
+    total_time,
+    calls,
+    samples
+};
+
+//
+// Sampling and call-count profiler attached to a state through lua_sethook.
+// All tables are allocated up front, attaching and detaching only installs or
+// removes the hook. Functions are identified by their source and first line,
+// C functions by their address. When the function table is full, further
+// functions are accounted to a shared "(other)" entry.
+//
+class profiler {
+public:
+    static constexpr std::size_t max_depth { 32 };
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct function {
+        const void* key;
+        int line;
+        bool used;
+        char name[112];
+        std::uint64_t calls;
+        std::uint64_t total_time;
+        std::uint64_t self_time;
+        std::uint64_t samples;
+    };
+    struct stack {
+        std::uint64_t hash;
+        std::uint32_t depth;
+        std::uint32_t frames[max_depth];
+        std::uint64_t count;
+    };
+    struct frame {
+        std::uint32_t function;
+        // identifies the stack level of the call, the field is a pointer or an index depending on the Lua version
+        decltype(lua_Debug::i_ci) level;
+        clock::time_point start;
+        std::uint64_t children;
+    };
+
+    std::vector<function> functions;
+    std::vector<stack> stacks;
+    std::vector<frame> frames;
+    std::size_t depth { 0 };
+    std::uint64_t dropped { 0 };
+    // owning instances keep the state open until the profiler detaches
+    base_state state { nullptr, false };
+
+    static constexpr char key {};
+
+    static profiler* find(lua_State* state) {
+        lua_pushlightuserdata(state, (void*)&key);
+        lua_rawget(state, LUA_REGISTRYINDEX);
+        auto self = static_cast<profiler*>(lua_touserdata(state, -1));
+        lua_pop(state, 1);
+        return self;
+    }
+
+    // changed by every attach and detach, invalidating the lookups cached by the hook
+    static std::atomic<std::uint64_t>& epoch() {
+        static std::atomic<std::uint64_t> value { 0 };
+        return value;
+    }
+    // the profiler of @state, looked up in the registry only when the state or the epoch changed
+    static profiler* find_cached(lua_State* state) {
+        struct cache {
+            lua_State* state;
+            profiler* self;
+            std::uint64_t epoch;
+        };
+        static thread_local cache last { nullptr, nullptr, 0 };
+        const auto current = epoch().load(std::memory_order_acquire);
+        if(last.state != state || last.epoch != current) last = { state, find(state), current };
+        return last.self;
+    }
+
+    // index of the function of @info, which has been filled with "S"
+    std::uint32_t lookup(lua_State* state, lua_Debug* info) {
+        const void* id = info->source;
+        if(*info->what == 'C') {
+            lua_getinfo(state, "f", info);
+            id = lua_topointer(state, -1);
+            lua_pop(state, 1);
+        }
+        const std::size_t mask = functions.size() - 1;
+        std::size_t index = (reinterpret_cast<std::uintptr_t>(id) * 31u + static_cast<std::size_t>(info->linedefined)) & mask;
+        // entry 0 is reserved for (other)
+        for(std::size_t probe = 0; probe < mask; ++probe, index = (index + 1) & mask) {
+            if(index == 0) continue;
+            auto& entry = functions[index];
+            if(entry.used && entry.key == id && entry.line == info->linedefined) return static_cast<std::uint32_t>(index);
+            if(!entry.used) {
+                lua_getinfo(state, "nf", info);
+                char global[64];
+                const char* name = info->name;
+                if(name) lua_pop(state, 1);
+                else if(utility::global_name(state, global, sizeof(global))) name = global;
+                else {
+                    lua_pop(state, 1);
+                    name = *info->what == 'm' ? "main chunk" : "?";
+                }
+                entry.used = true;
+                entry.key = id;
+                entry.line = info->linedefined;
+                if(*info->what == 'C') std::snprintf(entry.name, sizeof(entry.name), "%s [C]", name);
+                else std::snprintf(entry.name, sizeof(entry.name), "%s:%d (%.38s)", info->short_src, info->linedefined, name);
+                return static_cast<std::uint32_t>(index);
+            }
+        }
+        return 0;
+    }
+
+    void enter(lua_State* state, lua_Debug* info) {
+        const auto level = info->i_ci;
+        // a call made by the host, frames left by errors it caught are gone
+        lua_Debug caller;
+        if(state == static_cast<lua_State*>(this->state) && !lua_getstack(state, 1, &caller)) depth = 0;
+        lua_getinfo(state, "S", info);
+        const auto index = lookup(state, info);
+        ++functions[index].calls;
+        if(depth == frames.size()) {
+            ++dropped;
+            ++depth;
+            return;
+        }
+        frames[depth++] = { index, level, clock::now(), 0 };
+    }
+    void leave(lua_Debug* info) {
+        if(depth == 0) return;
+        if(depth > frames.size()) {
+            --depth;
+            return;
+        }
+        // frames unwound by an error had no return event, drop them up to the returning one
+        std::size_t match = depth;
+        while(match > 0 && frames[match - 1].level != info->i_ci) --match;
+        // returns of functions entered before attaching are ignored
+        if(match == 0) return;
+        depth = match - 1;
+        const auto& current = frames[depth];
+        const auto elapsed = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - current.start).count());
+        auto& entry = functions[current.function];
+        entry.total_time += elapsed;
+        entry.self_time += elapsed > current.children ? elapsed - current.children : 0;
+        if(depth > 0 && depth - 1 < frames.size()) frames[depth - 1].children += elapsed;
+    }
+    void sample(lua_State* state) {
+        stack current {};
+        lua_Debug info;
+        std::uint32_t reversed[max_depth];
+        std::uint32_t count = 0;
+        for(int level = 0; count < max_depth && lua_getstack(state, level, &info); ++level) {
+            lua_getinfo(state, "S", &info);
+            reversed[count++] = lookup(state, &info);
+        }
+        if(count == 0) return;
+        ++functions[reversed[0]].samples;
+        std::uint64_t hash { 14695981039346656037ull };
+        for(std::uint32_t i = 0; i < count; ++i) {
+            current.frames[i] = reversed[count - 1 - i];
+            hash = (hash ^ current.frames[i]) * 1099511628211ull;
+        }
+        const std::size_t mask = stacks.size() - 1;
+        for(std::size_t probe = 0, index = hash & mask; probe <= mask; ++probe, index = (index + 1) & mask) {
+            auto& entry = stacks[index];
+            if(entry.count == 0) {
+                current.hash = hash;
+                current.depth = count;
+                current.count = 1;
+                entry = current;
+                return;
+            }
+            if(entry.hash == hash && entry.depth == count &&
+                std::equal(entry.frames, entry.frames + count, current.frames)) {
+                ++entry.count;
+                return;
+            }
+        }
+        ++dropped;
+    }
+
+    static void hook(lua_State* state, lua_Debug* info) {
+        auto self = find_cached(state);
+        if(!self) return;
+        switch(info->event) {
+            case LUA_HOOKCALL:
+                self->enter(state, info);
+                break;
+#if LUA_VERSION_NUM >= 502
+            case LUA_HOOKTAILCALL:
+                // the caller's frame is replaced
+                self->leave(info);
+                self->enter(state, info);
+                break;
+#else
+            case LUA_HOOKTAILRET:
+#endif
+            case LUA_HOOKRET:
+                self->leave(info);
+                break;
+            case LUA_HOOKCOUNT:
+                self->sample(state);
+                break;
+        }
+    }
+
+    static std::size_t power_of_two(std::size_t size) {
+        std::size_t result = 2;
+        while(result < size) result *= 2;
+        return result;
+    }
+
+public:
+
+    //
+    // Create a profiler tracking up to @functions functions and @stacks distinct
+    // sampled call stacks.
+    //
+    explicit profiler(std::size_t functions = 1024, std::size_t stacks = 1024):
+    functions(power_of_two(functions)), stacks(power_of_two(stacks)), frames(256) {
+        reset();
+    }
+    ~profiler() {
+        detach();
+    }
+
+    profiler(const profiler&) = delete;
+    profiler& operator=(const profiler&) = delete;
+
+    //
+    // Start profiling @state. Every @sample_interval VM instructions the call stack
+    // is sampled, 0 disables sampling. If @track_calls is set, calls and time are
+    // recorded per function through call and return hooks.
+    // An owning @state is kept open while attached. A state_ref does not keep its
+    // state alive, the profiler must then be detached or destroyed before the state
+    // is closed. A state can only have one profiler attached at a time.
+    //
+    void attach(const base_state& state, int sample_interval = 1000, bool track_calls = true) {
+        detach();
+        if(find(state)) throw std::runtime_error("Could not attach: the state already has a profiler");
+        lua_pushlightuserdata(state, (void*)&key);
+        lua_pushlightuserdata(state, this);
+        lua_rawset(state, LUA_REGISTRYINDEX);
+        int mask = 0;
+        if(track_calls) mask |= LUA_MASKCALL | LUA_MASKRET;
+        if(sample_interval > 0) mask |= LUA_MASKCOUNT;
+        depth = 0;
+        this->state = state;
+        ++epoch();
+        lua_sethook(state, hook, mask, sample_interval);
+    }
+    void detach() {
+        if(!attached()) return;
+        lua_sethook(state, nullptr, 0, 0);
+        lua_pushlightuserdata(state, (void*)&key);
+        lua_pushnil(state);
+        lua_rawset(state, LUA_REGISTRYINDEX);
+        state = base_state { nullptr, false };
+        ++epoch();
+        depth = 0;
+    }
+    inline bool attached() const {
+        return static_cast<lua_State*>(state) != nullptr;
+    }
+
+    // clear all recorded data
+    void reset() {
+        std::fill(functions.begin(), functions.end(), function {});
+        std::fill(stacks.begin(), stacks.end(), stack {});
+        std::strcpy(functions[0].name, "(other)");
+        functions[0].used = true;
+        depth = 0;
+        dropped = 0;
+    }
+
+    // the @count functions ranking highest by @order
+    std::vector<profile_entry> top(std::size_t count, profile_order order = profile_order::self_time) const {
+        std::vector<profile_entry> entries;
+        for(const auto& entry: functions) {
+            if(!entry.used || (entry.calls == 0 && entry.samples == 0)) continue;
+            entries.push_back({ entry.name, entry.calls, entry.total_time, entry.self_time, entry.samples });
+        }
+        auto value = [order](const profile_entry& entry) {
+            switch(order) {
+                case profile_order::total_time: return entry.total_time;
+                case profile_order::calls: return entry.calls;
+                case profile_order::samples: return entry.samples;
+                default: return entry.self_time;
+            }
+        };
+        std::sort(entries.begin(), entries.end(), [&](const profile_entry& lhs, const profile_entry& rhs) {
+            return value(lhs) > value(rhs);
+        });
+        if(entries.size() > count) entries.resize(count);
+        return entries;
+    }
+
+    // top-N summary as a table of text
+    std::string summary(std::size_t count = 20, profile_order order = profile_order::self_time) const {
+        std::string text { "      calls    total ms     self ms   samples  function\n" };
+        char line[64];
+        for(const auto& entry: top(count, order)) {
+            std::snprintf(line, sizeof(line), "%11llu %11.3f %11.3f %9llu  ",
+                static_cast<unsigned long long>(entry.calls), static_cast<double>(entry.total_time) / 1e6,
+                static_cast<double>(entry.self_time) / 1e6, static_cast<unsigned long long>(entry.samples));
+            text += line;
+            text += entry.function;
+            text += "\n";
+        }
+        return text;
+    }
+
+    //
+    // Sampled call stacks in collapsed format, one "root;...;leaf count" line per
+    // stack, as read by flamegraph tools.
+    //
+    std::string collapsed() const {
+        std::string text;
+        for(const auto& entry: stacks) {
+            if(entry.count == 0) continue;
+            for(std::uint32_t i = 0; i < entry.depth; ++i) {
+                if(i) text += ";";
+                text += functions[entry.frames[i]].name;
+            }
+            text += " " + std::to_string(entry.count) + "\n";
+        }
+        return text;
+    }
+
+    // samples and frames that did not fit into the tables
+    inline std::uint64_t dropped_count() const {
+        return dropped;
+    }
+
+};
+
+}
@@ -0,0 +1,326 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  Result.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <cstring>
+#include <optional>
+
+
+
+namespace elsa {
+
+enum class call_status {
+    ok = 0,
+    runtime = LUA_ERRRUN,
+    syntax = LUA_ERRSYNTAX,
+    memory = LUA_ERRMEM,
+    handler = LUA_ERRERR,
+    file = LUA_ERRFILE,
+    // the results could not be converted to the requested types
+    conversion = -1
+};
+
+namespace utility {
+
+//
+// Call stack captured by the traceback message handler. Frames are copied into the
+// userdata when the error is raised and only formatted when requested.
+//
+struct trace {
+    static constexpr int max_frames { 16 };
+    struct frame {
+        char source[LUA_IDSIZE];
+        char name[48];
+        int line;
+    };
+    frame frames[max_frames];
+    int count;
+    bool truncated;
+};
+
+// set the value on top of the stack as the payload of the userdata at @index
+inline void set_payload(lua_State* state, int index) {
+    index = absolute_index(state, index);
+#if LUA_VERSION_NUM >= 503
+    lua_setuservalue(state, index);
+#else
+    lua_createtable(state, 1, 0);
+    lua_insert(state, -2);
+    lua_rawseti(state, -2, 1);
+#if LUA_VERSION_NUM == 502
+    lua_setuservalue(state, index);
+#else
+    lua_setfenv(state, index);
+#endif
+#endif
+}
+inline void push_payload(lua_State* state, int index) {
+#if LUA_VERSION_NUM >= 503
+    lua_getuservalue(state, index);
+#else
+#if LUA_VERSION_NUM == 502
+    lua_getuservalue(state, index);
+#else
+    lua_getfenv(state, index);
+#endif
+    lua_rawgeti(state, -1, 1);
+    lua_remove(state, -2);
+#endif
+}
+
+// the trace at @index or nullptr if the value is not a trace
+inline trace* to_trace(lua_State* state, int index) {
+    auto object = static_cast<trace*>(lua_touserdata(state, index));
+    if(!object || !lua_getmetatable(state, index)) return nullptr;
+    lua_pushlightuserdata(state, (void*)&registry_key<trace>::key);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    const bool same = lua_rawequal(state, -1, -2);
+    lua_pop(state, 2);
+    return same ? object : nullptr;
+}
+
+//
+// Functions called from C have no name since Lua 5.2, like luaL_traceback look for
+// a global holding the function on top of the stack, which is popped.
+//
+inline bool global_name(lua_State* state, char* name, std::size_t size) {
+    lua_pushglobaltable(state);
+    lua_pushnil(state);
+    while(lua_next(state, -2)) {
+        if(lua_type(state, -2) == LUA_TSTRING && lua_rawequal(state, -1, -4)) {
+            std::strncpy(name, lua_tostring(state, -2), size - 1);
+            name[size - 1] = '\0';
+            lua_pop(state, 4);
+            return true;
+        }
+        lua_pop(state, 1);
+    }
+    lua_pop(state, 2);
+    return false;
+}
+
+//
+// Message handler for lua_pcall wrapping the error object in a trace of the call stack.
+//
+inline int traceback_handler(lua_State* state) {
+    auto object = static_cast<trace*>(lua_newuserdata(state, sizeof(trace)));
+    object->count = 0;
+    object->truncated = false;
+    lua_Debug info;
+    for(int level = 1; lua_getstack(state, level, &info); ++level) {
+        if(object->count == trace::max_frames) {
+            object->truncated = true;
+            break;
+        }
+        lua_getinfo(state, "Slnf", &info);
+        auto& frame = object->frames[object->count++];
+        std::strncpy(frame.source, info.short_src, sizeof(frame.source) - 1);
+        frame.source[sizeof(frame.source) - 1] = '\0';
+        if(info.name || !global_name(state, frame.name, sizeof(frame.name))) {
+            lua_pop(state, 1);
+            std::strncpy(frame.name, info.name ? info.name : (*info.what == 'm' ? "main chunk" : "?"), sizeof(frame.name) - 1);
+            frame.name[sizeof(frame.name) - 1] = '\0';
+        }
+        frame.line = info.currentline;
+    }
+    lua_pushlightuserdata(state, (void*)&registry_key<trace>::key);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    if(lua_isnil(state, -1)) {
+        lua_pop(state, 1);
+        lua_newtable(state);
+        lua_pushlightuserdata(state, (void*)&registry_key<trace>::key);
+        lua_pushvalue(state, -2);
+        lua_rawset(state, LUA_REGISTRYINDEX);
+    }
+    lua_setmetatable(state, -2);
+    lua_pushvalue(state, 1);
+    set_payload(state, -2);
+    return 1;
+}
+
+}
+
+//
+// Error of a failed call. The error object stays owned by Lua through a registry
+// reference and is only converted to a string when the message is requested.
+// An error must not outlive its state.
+//
+class error {
+    lua_State* state { nullptr };
+    call_status status_ { call_status::ok };
+    int ref { LUA_NOREF };
+
+public:
+
+    error() = default;
+    // take the error object on top of the stack
+    error(lua_State* state, call_status status):
+    state(state), status_(status), ref(luaL_ref(state, LUA_REGISTRYINDEX)) {}
+    error(error&& rhs):
+    state(rhs.state), status_(rhs.status_), ref(rhs.ref) {
+        rhs.ref = LUA_NOREF;
+    }
+    error& operator=(error&& rhs) {
+        std::swap(state, rhs.state);
+        std::swap(status_, rhs.status_);
+        std::swap(ref, rhs.ref);
+        return *this;
+    }
+    ~error() {
+        if(ref != LUA_NOREF) luaL_unref(state, LUA_REGISTRYINDEX, ref);
+    }
+
+    inline explicit operator bool() const {
+        return status_ != call_status::ok;
+    }
+    inline call_status status() const {
+        return status_;
+    }
+
+    // push the error object, unwrapping traced errors
+    void push() const {
+        lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
+        if(utility::to_trace(state, -1)) {
+            utility::push_payload(state, -1);
+            lua_remove(state, -2);
+        }
+    }
+    std::string message() const {
+        if(!*this) return {};
+        utility::stack_guard guard {state};
+        push();
+        size_t length = 0;
+        const char* message = lua_tolstring(state, -1, &length);
+        if(!message) return "error object is not a string";
+        return std::string(message, length);
+    }
+    // the call stack formatted like debug.traceback, empty if the call was not traced
+    std::string traceback() const {
+        if(!*this) return {};
+        utility::stack_guard guard {state};
+        lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
+        auto trace = utility::to_trace(state, -1);
+        if(!trace) return {};
+        std::string traceback { "stack traceback:" };
+        for(int i = 0; i < trace->count; ++i) {
+            const auto& frame = trace->frames[i];
+            traceback += "\n\t";
+            traceback += frame.source;
+            if(frame.line > 0) traceback += ":" + std::to_string(frame.line);
+            traceback += ": in ";
+            traceback += frame.name;
+        }
+        if(trace->truncated) traceback += "\n\t...";
+        return traceback;
+    }
+};
+
+//
+// Value of a call that may have failed, without throwing:
+//
+//     auto score = state["score"].try_call<int>(record);
+//     if(score) use(*score);
+//     else log(score.error().message());
+//
+template<typename T>
+class result {
+    std::optional<T> value_ {};
+    elsa::error error_ {};
+
+public:
+
+    result(T value):
+    value_(std::move(value)) {}
+    result(elsa::error error):
+    error_(std::move(error)) {}
+
+    inline explicit operator bool() const {
+        return !error_;
+    }
+    inline const elsa::error& error() const {
+        return error_;
+    }
+    inline T& operator*() {
+        return *value_;
+    }
+    inline const T& operator*() const {
+        return *value_;
+    }
+    inline T* operator->() {
+        return &*value_;
+    }
+    // the value, throwing the error message if the call failed
+    T& value() {
+        if(error_) throw std::runtime_error(error_.message());
+        return *value_;
+    }
+    T value_or(T fallback) const {
+        return error_ ? std::move(fallback) : *value_;
+    }
+};
+template<>
+class result<void> {
+    elsa::error error_ {};
+
+public:
+
+    result() = default;
+    result(elsa::error error):
+    error_(std::move(error)) {}
+
+    inline explicit operator bool() const {
+        return !error_;
+    }
+    inline const elsa::error& error() const {
+        return error_;
+    }
+    void value() const {
+        if(error_) throw std::runtime_error(error_.message());
+    }
+};
+
+namespace utility {
+
+//
+// Call the function below @arguments values on the stack with lua_pcall, optionally
+// through the traceback handler. On failure the error object replaces the function.
+//
+inline int protected_call(lua_State* state, int arguments, int results, bool traced) {
+    if(!traced) return lua_pcall(state, arguments, results, 0);
+    const int handler = lua_gettop(state) - arguments;
+    lua_pushcfunction(state, traceback_handler);
+    lua_insert(state, handler);
+    const int status = lua_pcall(state, arguments, results, handler);
+    lua_remove(state, handler);
+    return status;
+}
+
+//
+// Read the results of a successful call into a result, converting exceptions
+// thrown by the getters into conversion errors.
+//
+template<typename... Ret>
+inline auto make_result(lua_State* state) {
+    using type = decltype(get<Ret...>(state));
+    using output = elsa::result<type>;
+    try {
+        if constexpr(std::is_void<type>::value) return output {};
+        else return output { get<Ret...>(state) };
+    }
+    catch(const std::exception& e) {
+        lua_pushstring(state, e.what());
+        return output { elsa::error { state, call_status::conversion } };
+    }
+}
+
+}
+
+}
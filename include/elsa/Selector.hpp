@@ -14,12 +14,31 @@
 
 namespace elsa {
 
+// failed call of a batch, @index refers to the position in the input range
+struct batch_error {
+    std::size_t index;
+    std::string message;
+};
+
+template<typename T>
+struct batch_result {
+    std::vector<T> results {};
+    std::vector<batch_error> errors {};
+};
+
 class selector {
     friend class state;
+    friend class thread;
    
     base_state state;
     std::vector<std::string> path {};
     
+    // bound mode: the resolved value is cached in the registry slot @ref and
+    // is valid as long as @bound_generation matches the state generation
+    const unsigned int* generation { nullptr };
+    mutable unsigned int bound_generation { 0 };
+    mutable int ref { LUA_NOREF };
+    
     selector(base_state state):
     state(state) { }
     selector(base_state state, std::string name, std::vector<std::string> path_):
@@ -27,16 +46,77 @@ class selector {
         path.push_back(name);
     }
     
+    void traverse(const std::size_t v_index, const int s_index, const std::size_t end) const {
+        if(v_index < end) {
+            const auto& name = path[v_index];
+            lua_pushlstring(state, name.data(), name.size());
+            lua_rawget(state, s_index);
+            traverse(v_index + 1, -2, end);
+        }
+    }
+    // push the table holding the selected value and the key of the value
+    void traverse_parent() const {
+        lua_pushglobaltable(state);
+        traverse(0, -2, path.size() - 1);
+        if(!lua_istable(state, -1)) throw std::runtime_error("Could not assign: " + path.back() + " has no parent table");
+        const auto& name = path.back();
+        lua_pushlstring(state, name.data(), name.size());
+    }
+    void set_pairs(int) {}
+    template<typename K, typename V, typename... Arg>
+    void set_pairs(int table, K&& key, V&& value, Arg&&... args) {
+        utility::push(state, std::forward<K>(key));
+        utility::push(state, std::forward<V>(value));
+        lua_rawset(state, table);
+        set_pairs(table, std::forward<Arg>(args)...);
+    }
+    template<typename... Ret, typename... Arg>
+    auto protected_call(bool traced, Arg&&... args) {
+        using output = decltype(utility::make_result<Ret...>(state));
+        utility::stack_guard guard {state};
+        push();
+        utility::push(state, std::forward<Arg>(args)...);
+        const int status = utility::protected_call(state, utility::arity<Arg...>::value, utility::arity<Ret...>::value, traced);
+        if(status != 0) return output { elsa::error { state, static_cast<call_status>(status) } };
+        return utility::make_result<Ret...>(state);
+    }
     void traverse(const std::size_t v_index, const int s_index) const {
         if(v_index < path.size()) {
-            lua_pushstring(state, path.at(v_index).c_str());
+            const auto& name = path[v_index];
+            lua_pushlstring(state, name.data(), name.size());
             lua_rawget(state, s_index);
             traverse(v_index + 1, -2);
         }
     }
     void traverse() const {
+        if(generation) {
+            if(ref != LUA_NOREF && bound_generation == *generation) {
+                lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
+                return;
+            }
+            resolve();
+            return;
+        }
+        lua_pushglobaltable(state);
+        traverse(0, -2);
+    }
+    // traverse the path and store the value in the registry, leaving it on the stack
+    void resolve() const {
         lua_pushglobaltable(state);
         traverse(0, -2);
+        if(lua_isnil(state, -1)) {
+            if(ref > 0) luaL_unref(state, LUA_REGISTRYINDEX, ref);
+            ref = LUA_REFNIL;
+        }
+        else if(ref > 0) {
+            lua_pushvalue(state, -1);
+            lua_rawseti(state, LUA_REGISTRYINDEX, ref);
+        }
+        else {
+            lua_pushvalue(state, -1);
+            ref = luaL_ref(state, LUA_REGISTRYINDEX);
+        }
+        bound_generation = *generation;
     }
 
 public:
@@ -45,13 +125,153 @@ public:
     state(state) {
         path.push_back(name);
     }
+    
+    selector(const selector& rhs):
+    state(rhs.state), path(rhs.path), generation(rhs.generation) { }
+    selector(selector&& rhs):
+    state(std::move(rhs.state)), path(std::move(rhs.path)),
+    generation(rhs.generation), bound_generation(rhs.bound_generation), ref(rhs.ref) {
+        rhs.generation = nullptr;
+        rhs.ref = LUA_NOREF;
+    }
+    //
+    // Assigning a selector writes the value it selects to the field selected by this
+    // one, like any other value. Values of selectors on another state are copied
+    // with copy_value.
+    //
+    selector& operator=(const selector& rhs) {
+        utility::stack_guard guard {state};
+        traverse_parent();
+        if((lua_State*)rhs.state == (lua_State*)state) rhs.push();
+        else {
+            utility::stack_guard source {rhs.state};
+            rhs.push();
+            copy_value(rhs.state, -1, state);
+        }
+        lua_rawset(state, -3);
+        utility::invalidate_generation(state);
+        return *this;
+    }
+    selector& operator=(selector&& rhs) {
+        return *this = static_cast<const selector&>(rhs);
+    }
+    // make this selector refer to the state and path of @rhs
+    selector& retarget(selector rhs) {
+        swap(*this, rhs);
+        return *this;
+    }
+    
+    ~selector() {
+        if(ref > 0 && (lua_State*)state) luaL_unref(state, LUA_REGISTRYINDEX, ref);
+    }
+    
+    friend void swap(selector& lhs, selector& rhs) noexcept {
+        swap(lhs.state, rhs.state);
+        std::swap(lhs.path, rhs.path);
+        std::swap(lhs.generation, rhs.generation);
+        std::swap(lhs.bound_generation, rhs.bound_generation);
+        std::swap(lhs.ref, rhs.ref);
+    }
+    
+    //
+    // Bind the selector: its path is resolved once into a registry reference and
+    // subsequent accesses cost a single lua_rawgeti. The binding is refreshed
+    // when code run through the state invalidates it or when rebind() is called.
+    // Calls through selectors keep it, functions replacing tables on the path of a
+    // bound selector require a rebind() or state::invalidate_bindings().
+    //
+    selector& bind() {
+        if(!generation) generation = utility::generation(state);
+        return *this;
+    }
+    selector& rebind() {
+        bind();
+        utility::stack_guard guard {state};
+        resolve();
+        return *this;
+    }
+    selector& unbind() {
+        if(ref > 0) luaL_unref(state, LUA_REGISTRYINDEX, ref);
+        ref = LUA_NOREF;
+        generation = nullptr;
+        return *this;
+    }
+    inline bool bound() const {
+        return generation != nullptr;
+    }
+
+    //
+    // Assign a value to the selected field: anything that can be pushed, function
+    // pointers and function objects. The path is traversed once to the parent
+    // table and the value stored with lua_rawset.
+    //
+    template<typename T, typename = std::enable_if_t<!std::is_same<std::decay_t<T>, selector>::value>>
+    selector& operator=(T&& value) {
+        utility::stack_guard guard {state};
+        traverse_parent();
+        if constexpr(utility::is_function<T>::value) utility::push_function(state, std::forward<T>(value));
+        else utility::push(state, std::forward<T>(value));
+        lua_rawset(state, -3);
+        utility::invalidate_generation(state);
+        return *this;
+    }
+
+    //
+    // Assign several fields of the selected table in a single traversal:
+    //
+    //     state["cfg"]["limits"].set_many("max", 5, "min", 1);
+    //
+    template<typename... Arg>
+    selector& set_many(Arg&&... args) {
+        static_assert(sizeof...(Arg) % 2 == 0, "set_many takes pairs of keys and values");
+        utility::stack_guard guard {state};
+        utility::check_stack(state, 3);
+        push();
+        if(!lua_istable(state, -1)) throw std::runtime_error("Could not assign: " + path.back() + " is not a table");
+        set_pairs(lua_gettop(state), std::forward<Arg>(args)...);
+        utility::invalidate_generation(state);
+        return *this;
+    }
+
+    // push the selected value onto the stack
+    void push() const {
+        const int top = lua_gettop(state);
+        traverse();
+        if(lua_gettop(state) > top + 1) {
+            lua_replace(state, top + 1);
+            lua_settop(state, top + 1);
+        }
+    }
+
+    //
+    // Ranges over the selected table for range-based for loops:
+    //
+    //     for(const auto& [name, score]: state["scores"].pairs<std::string, int>()) ...
+    //     for(const auto& [index, item]: state["items"].ipairs<std::string>()) ...
+    //
+    // The table is kept on the stack until the range is destroyed. Values that
+    // are not tables produce empty ranges.
+    //
+    template<typename K, typename V>
+    utility::pairs_range<K, V> pairs() const {
+        utility::check_stack(state, 1);
+        push();
+        return utility::pairs_range<K, V> { state };
+    }
+    template<typename V>
+    utility::ipairs_range<V> ipairs() const {
+        utility::check_stack(state, 1);
+        push();
+        return utility::ipairs_range<V> { state };
+    }
 
     inline auto operator[](std::string name) & {
         return selector {state, name, path};
     }
     inline auto operator[](std::string name) && {
+        unbind();
         path.push_back(name);
-        return *this;
+        return std::move(*this);
     }
 
     
@@ -79,6 +299,81 @@ public:
         return utility::get<Ret...>(state);
     }
     
+    //
+    // Call the selected function without throwing on Lua errors. The error is
+    // returned in the result and only converted to a message on request.
+    //
+    template<typename... Ret, typename... Arg>
+    auto try_call(Arg&&... args) {
+        return protected_call<Ret...>(false, std::forward<Arg>(args)...);
+    }
+    // like try_call, additionally capturing the call stack for error().traceback()
+    template<typename... Ret, typename... Arg>
+    auto try_call_traced(Arg&&... args) {
+        return protected_call<Ret...>(true, std::forward<Arg>(args)...);
+    }
+    
+    //
+    // Call the selected function once per element of @inputs and write the results
+    // to @out. Tuple elements are passed as multiple arguments. The function is
+    // resolved once and the stack is checked once for the whole batch.
+    // Failing calls do not abort the batch, they output default constructed values
+    // and are reported in the returned errors.
+    //
+    template<typename... Ret, typename Range, typename Out>
+    std::vector<batch_error> call_each(const Range& inputs, Out out) {
+        using input = std::decay_t<decltype(*std::begin(inputs))>;
+        using output = decltype(utility::get<Ret...>(state));
+        constexpr int arguments = static_cast<int>(utility::arity<input>::value);
+        constexpr int results = static_cast<int>(utility::arity<Ret...>::value);
+        std::vector<batch_error> errors;
+        utility::stack_guard guard {state};
+        push();
+        const int function = lua_gettop(state);
+        utility::check_stack(state, 1 + (arguments > results ? arguments : results));
+        std::size_t index = 0;
+        for(const auto& element: inputs) {
+            lua_pushvalue(state, function);
+            utility::push(state, element);
+            bool failed = lua_pcall(state, arguments, results, 0) != 0;
+            if(failed) {
+                const char* message = lua_tostring(state, -1);
+                errors.push_back({ index, message ? message : "error object is not a string" });
+            }
+            if constexpr(!std::is_void<output>::value) {
+                if(!failed) try {
+                    *out = utility::get<Ret...>(state);
+                }
+                catch(const std::exception& e) {
+                    errors.push_back({ index, e.what() });
+                    failed = true;
+                }
+                if(failed) *out = output {};
+                ++out;
+            }
+            lua_settop(state, function);
+            ++index;
+        }
+        return errors;
+    }
+    //
+    // Call the selected function once per element of @inputs like call_each,
+    // collecting the results in a vector.
+    //
+    template<typename... Ret, typename Range>
+    auto call_batch(const Range& inputs) {
+        using output = decltype(utility::get<Ret...>(state));
+        static_assert(!std::is_void<output>::value, "Batches without results are run through call_each");
+        batch_result<output> batch;
+        batch.results.reserve(static_cast<std::size_t>(std::distance(std::begin(inputs), std::end(inputs))));
+        batch.errors = call_each<Ret...>(inputs, std::back_inserter(batch.results));
+        return batch;
+    }
+    template<typename Range>
+    std::vector<batch_error> call_each(const Range& inputs) {
+        return call_each<>(inputs, static_cast<void*>(nullptr));
+    }
+    
     template<typename... Arg>
     class result {
         friend class selector;
@@ -143,14 +438,16 @@ public:
     }
     
     bool operator==(selector&& rhs) const {
-        return state == state && path == path;
+        return state == rhs.state && path == rhs.path;
     }
                 
     template<typename T>
     bool operator==(T&& rhs) const {
+        using type = std::conditional_t<std::is_same<std::decay_t<T>, const char*>::value ||
+            std::is_same<std::decay_t<T>, char*>::value, std::string, std::decay_t<T>>;
         utility::stack_guard guard {state};
         traverse();
-        return utility::get<T>(state);
+        return utility::get<type>(state) == rhs;
     }
 
 };
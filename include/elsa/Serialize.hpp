@@ -0,0 +1,466 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  Serialize.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+
+
+namespace elsa {
+namespace utility {
+
+//
+// Binary format: a version byte followed by one value. Values start with a tag,
+// integers are zigzag varints, numbers 8 byte IEEE doubles, strings a varint length
+// and their bytes. Tables store the length of their array part and the number of
+// remaining pairs as 4 byte counts, followed by the array values and the pairs.
+// Tables are numbered in order of appearance, repeated tables are written as a
+// reference to that number, so shared and cyclic tables are preserved.
+// Metatables, functions, userdata and threads are not supported.
+//
+
+enum class value_tag: unsigned char {
+    nil,
+    boolean_false,
+    boolean_true,
+    integer,
+    number,
+    string,
+    table,
+    reference
+};
+
+constexpr unsigned char serialize_version { 1 };
+constexpr int serialize_max_depth { 200 };
+
+namespace detail {
+    // whether the key at @index is an integer in [1, @length], stored in the array part
+    inline bool array_key(lua_State* state, int index, std::size_t length) {
+#if LUA_VERSION_NUM >= 503
+        if(!lua_isinteger(state, index)) return false;
+        const auto key = lua_tointeger(state, index);
+        return key >= 1 && static_cast<std::size_t>(key) <= length;
+#else
+        if(lua_type(state, index) != LUA_TNUMBER) return false;
+        const auto key = lua_tonumber(state, index);
+        return key >= 1 && key <= static_cast<lua_Number>(length) && key == std::floor(key);
+#endif
+    }
+    // whether the number at @index is stored as an integer, and its value
+    inline bool integer_value(lua_State* state, int index, std::int64_t& value) {
+#if LUA_VERSION_NUM >= 503
+        if(!lua_isinteger(state, index)) return false;
+        value = static_cast<std::int64_t>(lua_tointeger(state, index));
+        return true;
+#else
+        const auto number = lua_tonumber(state, index);
+        if(number != std::floor(number) || std::fabs(number) > 9007199254740992.0) return false;
+        value = static_cast<std::int64_t>(number);
+        return true;
+#endif
+    }
+    inline void push_integer(lua_State* state, std::int64_t value) {
+#if LUA_VERSION_NUM >= 503
+        lua_pushinteger(state, static_cast<lua_Integer>(value));
+#else
+        lua_pushnumber(state, static_cast<lua_Number>(value));
+#endif
+    }
+    inline const char* type_error(lua_State* state, int index) {
+        return lua_typename(state, lua_type(state, index));
+    }
+}
+
+class encoder {
+    lua_State* state;
+    std::string& out;
+    std::unordered_map<const void*, std::uint32_t> tables {};
+    int depth { 0 };
+
+    void tag(value_tag tag) {
+        out.push_back(static_cast<char>(tag));
+    }
+    void varint(std::uint64_t value) {
+        while(value >= 0x80) {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+    void patch(std::size_t position, std::uint32_t value) {
+        for(int i = 0; i < 4; ++i) out[position + i] = static_cast<char>(value >> (8 * i));
+    }
+
+    void number(int index) {
+        std::int64_t integer;
+        if(detail::integer_value(state, index, integer)) {
+            tag(value_tag::integer);
+            varint((static_cast<std::uint64_t>(integer) << 1) ^ static_cast<std::uint64_t>(integer >> 63));
+            return;
+        }
+        const double value = static_cast<double>(lua_tonumber(state, index));
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        tag(value_tag::number);
+        for(int i = 0; i < 8; ++i) out.push_back(static_cast<char>(bits >> (8 * i)));
+    }
+
+    void table(int index) {
+        const auto found = tables.find(lua_topointer(state, index));
+        if(found != tables.end()) {
+            tag(value_tag::reference);
+            varint(found->second);
+            return;
+        }
+        if(depth == serialize_max_depth) throw std::runtime_error("Could not serialize: tables are nested too deeply");
+        ++depth;
+        tables.emplace(lua_topointer(state, index), static_cast<std::uint32_t>(tables.size()));
+        check_stack(state, 3);
+        tag(value_tag::table);
+        const std::size_t counts = out.size();
+        out.append(8, '\0');
+        const std::size_t length = raw_length(state, index);
+        for(std::size_t i = 1; i <= length; ++i) {
+            lua_rawgeti(state, index, static_cast<int>(i));
+            value(-1);
+            lua_pop(state, 1);
+        }
+        std::uint32_t pairs = 0;
+        lua_pushnil(state);
+        while(lua_next(state, index)) {
+            if(!detail::array_key(state, -2, length)) {
+                value(-2);
+                value(-1);
+                ++pairs;
+            }
+            lua_pop(state, 1);
+        }
+        patch(counts, static_cast<std::uint32_t>(length));
+        patch(counts + 4, pairs);
+        --depth;
+    }
+
+public:
+
+    encoder(lua_State* state, std::string& out):
+    state(state), out(out) {}
+
+    void value(int index) {
+        index = absolute_index(state, index);
+        switch(lua_type(state, index)) {
+            case LUA_TNIL:
+                tag(value_tag::nil);
+                break;
+            case LUA_TBOOLEAN:
+                tag(lua_toboolean(state, index) ? value_tag::boolean_true : value_tag::boolean_false);
+                break;
+            case LUA_TNUMBER:
+                number(index);
+                break;
+            case LUA_TSTRING: {
+                std::size_t length = 0;
+                const char* string = lua_tolstring(state, index, &length);
+                tag(value_tag::string);
+                varint(length);
+                out.append(string, length);
+                break;
+            }
+            case LUA_TTABLE:
+                table(index);
+                break;
+            default:
+                throw std::runtime_error(std::string("Could not serialize a value of type ") + detail::type_error(state, index));
+        }
+    }
+};
+
+class decoder {
+    lua_State* state;
+    const unsigned char* data;
+    const unsigned char* end;
+    // stack index of the table mapping table numbers to decoded tables
+    int tables;
+    std::uint32_t count { 0 };
+    int depth { 0 };
+
+    [[noreturn]] static void malformed() {
+        throw std::runtime_error("Could not decode: malformed buffer");
+    }
+    inline std::size_t remaining() const {
+        return static_cast<std::size_t>(end - data);
+    }
+    unsigned char byte() {
+        if(data == end) malformed();
+        return *data++;
+    }
+    std::uint64_t varint() {
+        std::uint64_t value = 0;
+        for(int shift = 0; shift < 64; shift += 7) {
+            const unsigned char next = byte();
+            value |= static_cast<std::uint64_t>(next & 0x7f) << shift;
+            if(!(next & 0x80)) return value;
+        }
+        malformed();
+    }
+    std::uint32_t fixed() {
+        if(remaining() < 4) malformed();
+        std::uint32_t value = 0;
+        for(int i = 0; i < 4; ++i) value |= static_cast<std::uint32_t>(*data++) << (8 * i);
+        return value;
+    }
+
+    void table() {
+        if(depth == serialize_max_depth) malformed();
+        ++depth;
+        const std::uint32_t length = fixed();
+        const std::uint32_t pairs = fixed();
+        // every value takes at least one byte, reject counts the buffer cannot hold
+        if(length > remaining() || pairs > remaining() / 2) malformed();
+        check_stack(state, 4);
+        lua_createtable(state, static_cast<int>(length), static_cast<int>(pairs));
+        lua_pushvalue(state, -1);
+        lua_rawseti(state, tables, static_cast<int>(++count));
+        for(std::uint32_t i = 1; i <= length; ++i) {
+            value();
+            lua_rawseti(state, -2, static_cast<int>(i));
+        }
+        for(std::uint32_t i = 0; i < pairs; ++i) {
+            value();
+            // lua_rawset raises an error for nil and NaN keys, outside of any protected call
+            if(lua_isnil(state, -1)) malformed();
+            if(lua_type(state, -1) == LUA_TNUMBER) {
+                const lua_Number key = lua_tonumber(state, -1);
+                if(key != key) malformed();
+            }
+            value();
+            lua_rawset(state, -3);
+        }
+        --depth;
+    }
+
+public:
+
+    decoder(lua_State* state, const char* data, std::size_t size, int tables):
+    state(state), data(reinterpret_cast<const unsigned char*>(data)),
+    end(reinterpret_cast<const unsigned char*>(data) + size), tables(tables) {}
+
+    inline bool done() const {
+        return data == end;
+    }
+
+    void value() {
+        switch(static_cast<value_tag>(byte())) {
+            case value_tag::nil:
+                lua_pushnil(state);
+                break;
+            case value_tag::boolean_false:
+                lua_pushboolean(state, 0);
+                break;
+            case value_tag::boolean_true:
+                lua_pushboolean(state, 1);
+                break;
+            case value_tag::integer: {
+                const std::uint64_t zigzag = varint();
+                detail::push_integer(state, static_cast<std::int64_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1)));
+                break;
+            }
+            case value_tag::number: {
+                if(remaining() < 8) malformed();
+                std::uint64_t bits = 0;
+                for(int i = 0; i < 8; ++i) bits |= static_cast<std::uint64_t>(*data++) << (8 * i);
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                lua_pushnumber(state, static_cast<lua_Number>(value));
+                break;
+            }
+            case value_tag::string: {
+                const std::uint64_t length = varint();
+                if(length > remaining()) malformed();
+                lua_pushlstring(state, reinterpret_cast<const char*>(data), static_cast<std::size_t>(length));
+                data += length;
+                break;
+            }
+            case value_tag::table:
+                table();
+                break;
+            case value_tag::reference: {
+                const std::uint64_t id = varint();
+                if(id >= count) malformed();
+                lua_rawgeti(state, tables, static_cast<int>(id + 1));
+                break;
+            }
+            default:
+                malformed();
+        }
+    }
+};
+
+//
+// Deep copy of values between two states without an intermediate buffer.
+//
+class copier {
+    lua_State* from;
+    lua_State* to;
+    // stack index in @to of the table mapping table numbers to copies
+    int tables;
+    std::unordered_map<const void*, int> copies {};
+    int depth { 0 };
+
+    void table(int index) {
+        const auto found = copies.find(lua_topointer(from, index));
+        if(found != copies.end()) {
+            lua_rawgeti(to, tables, found->second);
+            return;
+        }
+        if(depth == serialize_max_depth) throw std::runtime_error("Could not copy: tables are nested too deeply");
+        ++depth;
+        check_stack(from, 3);
+        check_stack(to, 4);
+        const std::size_t length = raw_length(from, index);
+        lua_createtable(to, static_cast<int>(length), 0);
+        const int id = static_cast<int>(copies.size()) + 1;
+        copies.emplace(lua_topointer(from, index), id);
+        lua_pushvalue(to, -1);
+        lua_rawseti(to, tables, id);
+        for(std::size_t i = 1; i <= length; ++i) {
+            lua_rawgeti(from, index, static_cast<int>(i));
+            value(-1);
+            lua_pop(from, 1);
+            lua_rawseti(to, -2, static_cast<int>(i));
+        }
+        lua_pushnil(from);
+        while(lua_next(from, index)) {
+            if(!detail::array_key(from, -2, length)) {
+                value(-2);
+                value(-1);
+                lua_rawset(to, -3);
+            }
+            lua_pop(from, 1);
+        }
+        --depth;
+    }
+
+public:
+
+    copier(lua_State* from, lua_State* to, int tables):
+    from(from), to(to), tables(tables) {}
+
+    void value(int index) {
+        index = absolute_index(from, index);
+        switch(lua_type(from, index)) {
+            case LUA_TNIL:
+                lua_pushnil(to);
+                break;
+            case LUA_TBOOLEAN:
+                lua_pushboolean(to, lua_toboolean(from, index));
+                break;
+            case LUA_TNUMBER: {
+                std::int64_t integer;
+#if LUA_VERSION_NUM >= 503
+                if(detail::integer_value(from, index, integer)) detail::push_integer(to, integer);
+                else lua_pushnumber(to, lua_tonumber(from, index));
+#else
+                static_cast<void>(integer);
+                lua_pushnumber(to, lua_tonumber(from, index));
+#endif
+                break;
+            }
+            case LUA_TSTRING: {
+                std::size_t length = 0;
+                const char* string = lua_tolstring(from, index, &length);
+                lua_pushlstring(to, string, length);
+                break;
+            }
+            case LUA_TTABLE:
+                table(index);
+                break;
+            default:
+                throw std::runtime_error(std::string("Could not copy a value of type ") + detail::type_error(from, index));
+        }
+    }
+};
+
+}
+
+//
+// Append the binary encoding of the value at @index to @buffer.
+//
+inline void encode(lua_State* state, int index, std::string& buffer) {
+    index = utility::absolute_index(state, index);
+    const int top = lua_gettop(state);
+    buffer.push_back(static_cast<char>(utility::serialize_version));
+    try {
+        utility::encoder { state, buffer }.value(index);
+    }
+    catch(...) {
+        lua_settop(state, top);
+        throw;
+    }
+}
+inline std::string encode(lua_State* state, int index) {
+    std::string buffer;
+    encode(state, index, buffer);
+    return buffer;
+}
+
+//
+// Push the value encoded in @data. Throws on malformed buffers, leaving the stack unchanged.
+//
+inline void decode(lua_State* state, const char* data, std::size_t size) {
+    if(size == 0 || static_cast<unsigned char>(data[0]) != utility::serialize_version) {
+        throw std::runtime_error("Could not decode: unsupported format version");
+    }
+    const int top = lua_gettop(state);
+    utility::check_stack(state, 3);
+    lua_newtable(state);
+    try {
+        utility::decoder decoder { state, data + 1, size - 1, top + 1 };
+        decoder.value();
+        if(!decoder.done()) throw std::runtime_error("Could not decode: trailing data after the value");
+    }
+    catch(...) {
+        lua_settop(state, top);
+        throw;
+    }
+    lua_remove(state, top + 1);
+}
+inline void decode(lua_State* state, std::string_view buffer) {
+    decode(state, buffer.data(), buffer.size());
+}
+
+//
+// Push a deep copy of the value at @index of @from onto @to.
+//
+inline void copy_value(lua_State* from, int index, lua_State* to) {
+    if(from == to) {
+        decode(to, encode(from, index));
+        return;
+    }
+    index = utility::absolute_index(from, index);
+    const int from_top = lua_gettop(from);
+    const int top = lua_gettop(to);
+    utility::check_stack(to, 3);
+    lua_newtable(to);
+    try {
+        utility::copier { from, to, top + 1 }.value(index);
+    }
+    catch(...) {
+        lua_settop(from, from_top);
+        lua_settop(to, top);
+        throw;
+    }
+    lua_remove(to, top + 1);
+}
+
+}
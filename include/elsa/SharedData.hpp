@@ -0,0 +1,445 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  SharedData.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+
+namespace elsa {
+
+//
+// Immutable copy of a Lua value built once and exposed to any number of states as
+// read-only proxy userdata. Values are stored in flat arrays: the array part of
+// every table is a contiguous run of values, the remaining pairs an open-addressing
+// hash table with linear probing, and all strings share a single buffer.
+// Attaching a store to a state costs one userdata, nested tables are returned as
+// proxies of two words. Keys must be booleans, numbers or strings, values may also
+// be tables. Metatables are not copied.
+//
+class shared_data {
+public:
+
+    enum class type: std::uint8_t {
+        nil,
+        boolean,
+        integer,
+        number,
+        string,
+        table
+    };
+
+private:
+
+    struct value {
+        type kind { type::nil };
+        // length of strings
+        std::uint32_t length { 0 };
+        // boolean, integer, bits of a number, offset of a string or index of a table
+        std::uint64_t bits { 0 };
+    };
+    struct slot {
+        value key;
+        value data;
+    };
+    struct table {
+        std::uint32_t array;
+        std::uint32_t length;
+        std::uint32_t slots;
+        std::uint32_t capacity;
+    };
+    // a key read from a Lua stack, strings still point into the state
+    struct key {
+        type kind;
+        std::uint64_t bits;
+        const char* string;
+        std::size_t length;
+    };
+
+    std::vector<table> tables;
+    std::vector<value> arrays;
+    std::vector<slot> slots;
+    std::string strings;
+    value root;
+
+    static std::uint64_t hash(const key& key) {
+        std::uint64_t hash { 14695981039346656037ull };
+        if(key.kind == type::string) {
+            for(std::size_t i = 0; i < key.length; ++i) hash = (hash ^ static_cast<unsigned char>(key.string[i])) * 1099511628211ull;
+            return hash;
+        }
+        hash = (key.bits ^ static_cast<std::uint64_t>(key.kind)) * 0x9e3779b97f4a7c15ull;
+        return hash ^ (hash >> 32);
+    }
+    bool equal(const value& stored, const key& key) const {
+        if(stored.kind != key.kind) return false;
+        if(key.kind != type::string) return stored.bits == key.bits;
+        return stored.length == key.length && std::memcmp(strings.data() + stored.bits, key.string, key.length) == 0;
+    }
+
+    // index of the slot holding @key in @owner, or -1
+    std::int64_t find(const table& owner, const key& key) const {
+        if(owner.capacity == 0) return -1;
+        const std::size_t mask = owner.capacity - 1;
+        for(std::size_t index = hash(key) & mask;; index = (index + 1) & mask) {
+            const auto& entry = slots[owner.slots + index];
+            if(entry.key.kind == type::nil) return -1;
+            if(equal(entry.key, key)) return static_cast<std::int64_t>(index);
+        }
+    }
+
+    static bool to_key(lua_State* state, int index, key& key) {
+        key.string = nullptr;
+        key.length = 0;
+        switch(lua_type(state, index)) {
+            case LUA_TBOOLEAN:
+                key.kind = type::boolean;
+                key.bits = lua_toboolean(state, index) ? 1 : 0;
+                return true;
+            case LUA_TNUMBER: {
+                std::int64_t integer;
+                if(utility::detail::integer_value(state, index, integer)) {
+                    key.kind = type::integer;
+                    key.bits = static_cast<std::uint64_t>(integer);
+                }
+                else {
+                    // floats with an integral value address the same field as the integer, as in Lua tables
+                    const double number = static_cast<double>(lua_tonumber(state, index));
+                    if(number == std::floor(number) && number >= -9223372036854775808.0 && number < 9223372036854775808.0) {
+                        key.kind = type::integer;
+                        key.bits = static_cast<std::uint64_t>(static_cast<std::int64_t>(number));
+                        return true;
+                    }
+                    key.kind = type::number;
+                    std::memcpy(&key.bits, &number, sizeof(number));
+                }
+                return true;
+            }
+            case LUA_TSTRING:
+                key.kind = type::string;
+                key.string = lua_tolstring(state, index, &key.length);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    class builder;
+
+    //
+    // Proxy userdata referring to one table of a store. The store is kept alive by
+    // the state it was attached to.
+    //
+    struct proxy {
+        const shared_data* data;
+        std::uint32_t table;
+    };
+
+    static void push_metatable(lua_State* state) {
+        lua_pushlightuserdata(state, (void*)&utility::registry_key<proxy>::key);
+        lua_rawget(state, LUA_REGISTRYINDEX);
+        if(!lua_isnil(state, -1)) return;
+        lua_pop(state, 1);
+        lua_createtable(state, 0, 6);
+        lua_pushcfunction(state, meta_index);
+        lua_setfield(state, -2, "__index");
+        lua_pushcfunction(state, meta_len);
+        lua_setfield(state, -2, "__len");
+        lua_pushcfunction(state, meta_newindex);
+        lua_setfield(state, -2, "__newindex");
+        lua_pushcfunction(state, meta_pairs);
+        lua_setfield(state, -2, "__pairs");
+        lua_pushcfunction(state, meta_eq);
+        lua_setfield(state, -2, "__eq");
+        lua_pushliteral(state, "shared data");
+        lua_setfield(state, -2, "__metatable");
+        lua_pushlightuserdata(state, (void*)&utility::registry_key<proxy>::key);
+        lua_pushvalue(state, -2);
+        lua_rawset(state, LUA_REGISTRYINDEX);
+    }
+
+    static const proxy& to_proxy(lua_State* state, int index) {
+        auto object = static_cast<proxy*>(lua_touserdata(state, index));
+        bool valid = object && lua_getmetatable(state, index);
+        if(valid) {
+            lua_pushlightuserdata(state, (void*)&utility::registry_key<proxy>::key);
+            lua_rawget(state, LUA_REGISTRYINDEX);
+            valid = lua_rawequal(state, -1, -2);
+            lua_pop(state, 2);
+        }
+        if(!valid) luaL_argerror(state, index, "shared data expected");
+        return *object;
+    }
+
+    void push(lua_State* state, const value& value) const {
+        switch(value.kind) {
+            case type::nil:
+                lua_pushnil(state);
+                break;
+            case type::boolean:
+                lua_pushboolean(state, value.bits != 0);
+                break;
+            case type::integer:
+                utility::detail::push_integer(state, static_cast<std::int64_t>(value.bits));
+                break;
+            case type::number: {
+                double number;
+                std::memcpy(&number, &value.bits, sizeof(number));
+                lua_pushnumber(state, static_cast<lua_Number>(number));
+                break;
+            }
+            case type::string:
+                lua_pushlstring(state, strings.data() + value.bits, value.length);
+                break;
+            case type::table: {
+                auto object = static_cast<proxy*>(lua_newuserdata(state, sizeof(proxy)));
+                object->data = this;
+                object->table = static_cast<std::uint32_t>(value.bits);
+                push_metatable(state);
+                lua_setmetatable(state, -2);
+                break;
+            }
+        }
+    }
+
+    static int meta_index(lua_State* state) {
+        const auto& self = to_proxy(state, 1);
+        const auto& owner = self.data->tables[self.table];
+        key key;
+        if(!to_key(state, 2, key)) {
+            lua_pushnil(state);
+            return 1;
+        }
+        if(key.kind == type::integer && key.bits - 1 < owner.length) {
+            self.data->push(state, self.data->arrays[owner.array + key.bits - 1]);
+            return 1;
+        }
+        const auto found = self.data->find(owner, key);
+        if(found < 0) lua_pushnil(state);
+        else self.data->push(state, self.data->slots[owner.slots + found].data);
+        return 1;
+    }
+    static int meta_len(lua_State* state) {
+        const auto& self = to_proxy(state, 1);
+        lua_pushinteger(state, static_cast<lua_Integer>(self.data->tables[self.table].length));
+        return 1;
+    }
+    static int meta_newindex(lua_State* state) {
+        return luaL_error(state, "attempt to modify read-only shared data");
+    }
+    static int meta_eq(lua_State* state) {
+        const auto& lhs = to_proxy(state, 1);
+        const auto& rhs = to_proxy(state, 2);
+        lua_pushboolean(state, lhs.data == rhs.data && lhs.table == rhs.table);
+        return 1;
+    }
+    static int meta_next(lua_State* state) {
+        const auto& self = to_proxy(state, 1);
+        const auto& owner = self.data->tables[self.table];
+        // position 0 to length walks the array part, the slots follow
+        std::size_t position = 0;
+        if(!lua_isnil(state, 2)) {
+            key key;
+            if(!to_key(state, 2, key)) return luaL_error(state, "invalid key to 'next'");
+            if(key.kind == type::integer && key.bits - 1 < owner.length) position = static_cast<std::size_t>(key.bits);
+            else {
+                const auto found = self.data->find(owner, key);
+                if(found < 0) return luaL_error(state, "invalid key to 'next'");
+                position = owner.length + static_cast<std::size_t>(found) + 1;
+            }
+        }
+        for(; position < owner.length; ++position) {
+            const auto& value = self.data->arrays[owner.array + position];
+            if(value.kind == type::nil) continue;
+            utility::detail::push_integer(state, static_cast<std::int64_t>(position + 1));
+            self.data->push(state, value);
+            return 2;
+        }
+        for(position -= owner.length; position < owner.capacity; ++position) {
+            const auto& entry = self.data->slots[owner.slots + position];
+            if(entry.key.kind == type::nil) continue;
+            self.data->push(state, entry.key);
+            self.data->push(state, entry.data);
+            return 2;
+        }
+        lua_pushnil(state);
+        return 1;
+    }
+    static int meta_pairs(lua_State* state) {
+        to_proxy(state, 1);
+        lua_pushcfunction(state, meta_next);
+        lua_pushvalue(state, 1);
+        lua_pushnil(state);
+        return 3;
+    }
+
+    // stores attached to a state, released when it is closed
+    struct anchors {
+        std::vector<std::shared_ptr<const shared_data>> stores;
+    };
+
+    shared_data() = default;
+
+public:
+
+    //
+    // Build a store from the value at @index, usually a table loaded in a
+    // separate builder state that can be closed afterwards.
+    //
+    static std::shared_ptr<const shared_data> build(lua_State* state, int index);
+
+    //
+    // Push the root of @data, keeping it alive until @state is closed.
+    //
+    static void push(lua_State* state, const std::shared_ptr<const shared_data>& data) {
+        utility::check_stack(state, 4);
+        auto& stores = utility::registry_object<anchors>(state).stores;
+        if(std::find(stores.begin(), stores.end(), data) == stores.end()) stores.push_back(data);
+        data->push(state, data->root);
+    }
+
+    inline std::size_t table_count() const {
+        return tables.size();
+    }
+    // bytes held by the store
+    std::size_t memory() const {
+        return sizeof(*this) + tables.capacity() * sizeof(table) + arrays.capacity() * sizeof(value) +
+            slots.capacity() * sizeof(slot) + strings.capacity();
+    }
+};
+
+class shared_data::builder {
+    lua_State* state;
+    shared_data& data;
+    std::unordered_map<const void*, std::uint32_t> copies {};
+    std::unordered_map<std::string, std::uint32_t> strings {};
+    int depth { 0 };
+
+    value string(int index) {
+        std::size_t length = 0;
+        const char* string = lua_tolstring(state, index, &length);
+        if(length > UINT32_MAX) throw std::runtime_error("Could not share: string too long");
+        auto found = strings.emplace(std::string(string, length), static_cast<std::uint32_t>(data.strings.size()));
+        if(found.second) data.strings.append(string, length);
+        value result;
+        result.kind = type::string;
+        result.length = static_cast<std::uint32_t>(length);
+        result.bits = found.first->second;
+        return result;
+    }
+
+    value convert(int index, bool is_key) {
+        index = utility::absolute_index(state, index);
+        const int kind = lua_type(state, index);
+        if(kind == LUA_TSTRING) return string(index);
+        if(kind == LUA_TTABLE && !is_key) return table(index);
+        key key;
+        if(to_key(state, index, key)) {
+            value result;
+            result.kind = key.kind;
+            result.bits = key.bits;
+            return result;
+        }
+        if(kind == LUA_TNIL && !is_key) return {};
+        throw std::runtime_error(std::string("Could not share ") + (is_key ? "a key" : "a value") +
+            " of type " + utility::detail::type_error(state, index));
+    }
+
+    value table(int index) {
+        value result;
+        result.kind = type::table;
+        const auto found = copies.find(lua_topointer(state, index));
+        if(found != copies.end()) {
+            result.bits = found->second;
+            return result;
+        }
+        if(depth == utility::serialize_max_depth) throw std::runtime_error("Could not share: tables are nested too deeply");
+        ++depth;
+        utility::check_stack(state, 3);
+        const auto id = static_cast<std::uint32_t>(data.tables.size());
+        copies.emplace(lua_topointer(state, index), id);
+        data.tables.push_back({});
+        result.bits = id;
+
+        // children are converted first, the parts of this table are appended afterwards
+        const std::size_t length = utility::raw_length(state, index);
+        std::vector<value> array;
+        array.reserve(length);
+        for(std::size_t i = 1; i <= length; ++i) {
+            lua_rawgeti(state, index, static_cast<int>(i));
+            array.push_back(convert(-1, false));
+            lua_pop(state, 1);
+        }
+        std::vector<slot> pairs;
+        lua_pushnil(state);
+        while(lua_next(state, index)) {
+            if(!utility::detail::array_key(state, -2, length)) pairs.push_back({ convert(-2, true), convert(-1, false) });
+            lua_pop(state, 1);
+        }
+
+        std::uint32_t capacity = 0;
+        if(!pairs.empty()) {
+            capacity = 2;
+            while(capacity < pairs.size() * 2) capacity *= 2;
+        }
+        auto& entry = data.tables[id];
+        entry.array = static_cast<std::uint32_t>(data.arrays.size());
+        entry.length = static_cast<std::uint32_t>(length);
+        entry.slots = static_cast<std::uint32_t>(data.slots.size());
+        entry.capacity = capacity;
+        data.arrays.insert(data.arrays.end(), array.begin(), array.end());
+        data.slots.resize(data.slots.size() + capacity);
+        for(const auto& pair: pairs) {
+            shared_data::key key { pair.key.kind, pair.key.bits,
+                pair.key.kind == type::string ? data.strings.data() + pair.key.bits : nullptr, pair.key.length };
+            const std::size_t mask = capacity - 1;
+            std::size_t slot = shared_data::hash(key) & mask;
+            while(data.slots[entry.slots + slot].key.kind != type::nil) slot = (slot + 1) & mask;
+            data.slots[entry.slots + slot] = pair;
+        }
+        --depth;
+        return result;
+    }
+
+public:
+
+    builder(lua_State* state, shared_data& data):
+    state(state), data(data) {}
+
+    void build(int index) {
+        data.root = convert(index, false);
+        data.tables.shrink_to_fit();
+        data.arrays.shrink_to_fit();
+        data.slots.shrink_to_fit();
+        data.strings.shrink_to_fit();
+    }
+};
+
+inline std::shared_ptr<const shared_data> shared_data::build(lua_State* state, int index) {
+    std::shared_ptr<shared_data> data { new shared_data {} };
+    const int top = lua_gettop(state);
+    try {
+        builder { state, *data }.build(index);
+    }
+    catch(...) {
+        lua_settop(state, top);
+        throw;
+    }
+    return data;
+}
+
+}
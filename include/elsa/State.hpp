@@ -11,10 +11,24 @@
 #pragma once
 
 #include "Utility.hpp"
+#include "Array.hpp"
+#include "Function.hpp"
+#include "Usertype.hpp"
+#include "TableFields.hpp"
 #include "Definitions.hpp"
+#include "Allocator.hpp"
+#include "GarbageCollector.hpp"
 #include "BaseState.hpp"
+#include "Result.hpp"
+#include "TableRange.hpp"
+#include "Serialize.hpp"
 #include "Selector.hpp"
+#include "StaticPath.hpp"
 #include "Tuple.hpp"
+#include "ChunkCache.hpp"
+#include "MappedFile.hpp"
+#include "BytecodeCache.hpp"
+#include "SharedData.hpp"
 
 
 
@@ -27,9 +41,19 @@ static int wrap_exceptions(lua_State*, lua_CFunction);
 #endif
 
 class state: public base_state {
-public:
     
-    state(bool open_libs = false): base_state(luaL_newstate(), true) {
+    int load_string(const std::string& code) {
+        auto cache = utility::find_registry_object<chunk_cache>(lstate);
+        if(cache && cache->enabled()) return cache->load(lstate, code);
+        return luaL_loadstring(lstate, code.c_str());
+    }
+    int load_file(const std::string& file) {
+        auto cache = utility::find_registry_object<bytecode_cache>(lstate);
+        if(cache && cache->enabled()) return cache->load(lstate, file);
+        return luaL_loadfile(lstate, file.c_str());
+    }
+    
+    void initialize(bool open_libs) {
         if(!lstate) throw std::runtime_error("Could not create Lua lstate");
         if(open_libs) luaL_openlibs(lstate);
 #if defined(LUAJIT_VERSION) && defined(DEBUG)
@@ -39,6 +63,27 @@ public:
 #endif
     }
     
+public:
+    
+    state(bool open_libs = false): base_state(luaL_newstate(), true) {
+        initialize(open_libs);
+    }
+    //
+    // Create a state allocating through an arena with the given @policy,
+    // see memory() for its statistics.
+    //
+    state(const allocator_policy& policy, bool open_libs = false):
+    base_state(utility::new_state(policy), true) {
+        initialize(open_libs);
+    }
+    //
+    // Create a state allocating through @allocator, which receives @userdata.
+    //
+    state(lua_Alloc allocator, void* userdata, bool open_libs = false):
+    base_state(lua_newstate(allocator, userdata), true) {
+        initialize(open_libs);
+    }
+    
     using base_state::base_state;
     using base_state::operator=;
     
@@ -46,13 +91,71 @@ public:
     void collect_garbage() {
         lua_gc(lstate, LUA_GCCOLLECT, 0);
     }
+    // incremental collection control: stop, budgeted steps, tuning and statistics
+    elsa::gc gc() const {
+        return elsa::gc { lstate };
+    }
+    // memory statistics of the arena, states using another allocator only report live bytes
+    memory_stats memory() const {
+        if(auto arena = utility::find_arena(lstate)) return arena->stats();
+        memory_stats stats;
+        stats.live = utility::gc_count(lstate);
+        return stats;
+    }
+    // change the hard cap of an arena state, 0 removes it
+    void set_memory_limit(std::size_t limit) {
+        auto arena = utility::find_arena(lstate);
+        if(!arena) throw std::runtime_error("Memory limits require a state created with an allocator policy");
+        arena->set_limit(limit);
+    }
     void clear_stack() {
         lua_settop(lstate, 0);
     }
     
+    // force bound selectors to resolve their paths again on next access
+    void invalidate_bindings() {
+        utility::invalidate_generation(lstate);
+    }
+    
+    //
+    // Cache compiled chunks run through operator() and call() so repeated snippets
+    // skip the parser. The cache keeps up to @capacity chunks and evicts the least
+    // recently used ones. The cache is shared by all instances accessing the Lua state.
+    //
+    void enable_chunk_cache(std::size_t capacity = 64) {
+        utility::registry_object<chunk_cache>(lstate).resize(lstate, capacity);
+    }
+    void disable_chunk_cache() {
+        if(auto cache = utility::find_registry_object<chunk_cache>(lstate)) {
+            cache->clear(lstate);
+            cache->resize(lstate, 0);
+        }
+    }
+    cache_stats chunk_cache_stats() const {
+        if(auto cache = utility::find_registry_object<chunk_cache>(lstate)) return cache->stats();
+        return {};
+    }
+    
+    //
+    // Keep compiled chunks of files run through load() on disk, in @directory or
+    // next to the source files if empty. Entries are bound to the Lua version and
+    // the modification time, size and content of their source.
+    //
+    void enable_bytecode_cache(const std::string& directory = {}) {
+        utility::registry_object<bytecode_cache>(lstate).enable(directory);
+    }
+    void disable_bytecode_cache() {
+        if(auto cache = utility::find_registry_object<bytecode_cache>(lstate)) cache->disable();
+    }
+    bytecode_stats bytecode_cache_stats() const {
+        if(auto cache = utility::find_registry_object<bytecode_cache>(lstate)) return cache->stats();
+        return {};
+    }
+    
     void operator()(const std::string& code) {
         utility::stack_guard guard {*this};
-        int status = luaL_loadstring(lstate, code.c_str()) || lua_pcall(lstate, 0, LUA_MULTRET, 0);
+        utility::generation_guard bindings {lstate};
+        int status = load_string(code) || lua_pcall(lstate, 0, LUA_MULTRET, 0);
         if(status != 0) {
             std::string error = lua_tostring(lstate, -1);
             throw std::runtime_error("Could not load string: " + error);
@@ -61,25 +164,104 @@ public:
     template<typename... Ret>
     auto call(const std::string& code) {
         utility::stack_guard guard {*this};
-        int status = luaL_loadstring(lstate, code.c_str()) || lua_pcall(lstate, 0, utility::arity<Ret...>::value, 0);
+        utility::generation_guard bindings {lstate};
+        int status = load_string(code) || lua_pcall(lstate, 0, utility::arity<Ret...>::value, 0);
         if(status != 0) {
             std::string error = lua_tostring(lstate, -1);
-            lua_settop(lstate, 0);
             throw std::runtime_error("Could not load string: " + error);
         }
         return utility::get<Ret...>(lstate);
         //return utility::pop<Ret...>(lstate);
     }
     
+    //
+    // Run @code without throwing on Lua errors, see selector::try_call.
+    //
+    template<typename... Ret>
+    auto try_call(const std::string& code) {
+        using output = decltype(utility::make_result<Ret...>(lstate));
+        utility::stack_guard guard {*this};
+        utility::generation_guard bindings {lstate};
+        int status = load_string(code);
+        if(status == 0) status = lua_pcall(lstate, 0, utility::arity<Ret...>::value, 0);
+        if(status != 0) return output { error { lstate, static_cast<call_status>(status) } };
+        return utility::make_result<Ret...>(lstate);
+    }
+    result<void> try_load(const std::string& file) {
+        utility::stack_guard guard {*this};
+        utility::generation_guard bindings {lstate};
+        int status = load_file(file);
+        if(status == 0) status = lua_pcall(lstate, 0, 0, 0);
+        if(status != 0) return error { lstate, static_cast<call_status>(status) };
+        return {};
+    }
+    
     void load(const std::string& file) {
         utility::stack_guard guard {*this};
-        int status = luaL_loadfile(lstate, file.c_str()) || lua_pcall(lstate, 0, LUA_MULTRET, 0);
+        utility::generation_guard bindings {lstate};
+        int status = load_file(file) || lua_pcall(lstate, 0, LUA_MULTRET, 0);
         if(status != 0) {
             std::string error = lua_tostring(lstate, -1);
-            lua_settop(lstate, 0);
             throw std::runtime_error("Could not load file " + file + ": " + error);
         }
     }
+    //
+    // Run a script or bytecode file through a memory mapping of it instead of
+    // reading it through stdio. Large files are never copied into a buffer.
+    //
+    void load_mapped(const std::string& file) {
+        utility::mapped_file mapping { file };
+        utility::stack_guard guard {*this};
+        utility::generation_guard bindings {lstate};
+        int status = utility::load_buffer(lstate, mapping.data(), mapping.size(), "@" + file) ||
+            lua_pcall(lstate, 0, LUA_MULTRET, 0);
+        if(status != 0) {
+            std::string error = lua_tostring(lstate, -1);
+            throw std::runtime_error("Could not load file " + file + ": " + error);
+        }
+    }
+    //
+    // Run a script or bytecode chunk held in memory, such as a byte array compiled
+    // into the binary. Errors refer to the chunk as @name.
+    //
+    void load_buffer(const char* data, std::size_t size, const std::string& name) {
+        utility::stack_guard guard {*this};
+        utility::generation_guard bindings {lstate};
+        int status = utility::load_buffer(lstate, data, size, "=" + name) || lua_pcall(lstate, 0, LUA_MULTRET, 0);
+        if(status != 0) {
+            std::string error = lua_tostring(lstate, -1);
+            throw std::runtime_error("Could not load buffer " + name + ": " + error);
+        }
+    }
+    void load_buffer(const unsigned char* data, std::size_t size, const std::string& name) {
+        load_buffer(reinterpret_cast<const char*>(data), size, name);
+    }
+    void load_buffer(std::string_view buffer, const std::string& name) {
+        load_buffer(buffer.data(), buffer.size(), name);
+    }
+    
+    //
+    // Expose @data as the read-only global @name. The store is shared with every
+    // other state it is attached to and released when the last of them is closed.
+    //
+    void share(const std::string& name, const std::shared_ptr<const shared_data>& data) {
+        utility::stack_guard guard {*this};
+        shared_data::push(lstate, data);
+        lua_setglobal(lstate, name.c_str());
+        invalidate_bindings();
+    }
+    
+    //
+    // Expose a function pointer or function object to Lua as the global @name.
+    //
+    template<typename F>
+    void set_function(const std::string& name, F&& function) {
+        utility::stack_guard guard {*this};
+        lua_pushglobaltable(lstate);
+        utility::push(lstate, name);
+        utility::push_function(lstate, std::forward<F>(function));
+        lua_rawset(lstate, -3);
+    }
     
     template<typename T>
     selector operator[](T&& name) {
@@ -89,22 +271,42 @@ public:
     template<typename... T>
     selector select(T&&... name) {
         selector s {*this};
-        ((s = std::move(s)[name]), ...);
+        (s.retarget(std::move(s)[name]), ...);
         return s;
     }
+#if defined(ELSA_HAS_STATIC_PATHS)
+    //
+    // Select a dot separated path known at compile time: state.get<"config.limits">().
+    // No memory is allocated and the state's reference count is not touched.
+    //
+    template<fixed_string Path>
+    auto get() const {
+        return static_selector<utility::dotted_segments<Path>> {lstate};
+    }
+#endif
     template<typename T>
     selector select(T&& name, const char delim = '.') {
         std::istringstream str(name);
         std::string buf;
         selector s {*this};
         while(std::getline(str, buf, delim)) {
-            s = std::move(s)[buf];
+            s.retarget(std::move(s)[buf]);
         }
         return s;
     }
     
 };
 
+//
+// Non-owning view of a state. Creating and copying it, or selectors created
+// through it, neither allocates nor touches a reference count.
+// A state_ref must not outlive the state it refers to.
+//
+class state_ref: public state {
+public:
+    state_ref(lua_State* lstate): state(lstate, false) {}
+};
+
 
 #if defined(LUAJIT_VERSION) && defined(DEBUG)
 namespace utility {
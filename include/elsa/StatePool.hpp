@@ -0,0 +1,222 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  StatePool.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+
+
+namespace elsa {
+
+struct pool_stats {
+    std::size_t size { 0 };
+    std::size_t in_use { 0 };
+    std::size_t acquisitions { 0 };
+    std::size_t affinity_hits { 0 };
+    std::size_t free_list_hits { 0 };
+    std::size_t waits { 0 };
+};
+
+//
+// Fixed set of identically initialized states handed out through RAII leases.
+// A thread first tries the state it used last, then falls back to a lock-free
+// free list of idle states.
+//
+class state_pool {
+
+    static constexpr std::uint32_t none { 0xffffffffu };
+
+    struct slot {
+        elsa::state state;
+        std::atomic<bool> idle { true };
+        // whether the slot is linked into the free list, possibly as a stale entry
+        std::atomic<bool> listed { false };
+        std::atomic<std::uint32_t> next { none };
+
+        slot(bool open_libs): state(open_libs) {}
+    };
+
+    std::vector<std::unique_ptr<slot>> slots;
+    // free list head: slot index in the low and an ABA tag in the high 32 bits
+    std::atomic<std::uint64_t> head { none };
+
+    struct {
+        std::atomic<std::size_t> in_use { 0 };
+        std::atomic<std::size_t> acquisitions { 0 };
+        std::atomic<std::size_t> affinity_hits { 0 };
+        std::atomic<std::size_t> free_list_hits { 0 };
+        std::atomic<std::size_t> waits { 0 };
+    } counters;
+
+    struct affinity {
+        const state_pool* pool { nullptr };
+        std::uint32_t index { none };
+    };
+    static affinity& thread_affinity() {
+        thread_local affinity value;
+        return value;
+    }
+
+    void push_free(std::uint32_t index) {
+        std::uint64_t top = head.load(std::memory_order_relaxed);
+        std::uint64_t next;
+        do {
+            slots[index]->next.store(static_cast<std::uint32_t>(top), std::memory_order_relaxed);
+            next = ((top >> 32) + 1) << 32 | index;
+        } while(!head.compare_exchange_weak(top, next, std::memory_order_release, std::memory_order_relaxed));
+    }
+    std::uint32_t pop_free() {
+        std::uint64_t top = head.load(std::memory_order_acquire);
+        std::uint64_t next;
+        do {
+            const auto index = static_cast<std::uint32_t>(top);
+            if(index == none) return none;
+            next = ((top >> 32) + 1) << 32 | slots[index]->next.load(std::memory_order_relaxed);
+        } while(!head.compare_exchange_weak(top, next, std::memory_order_acquire, std::memory_order_acquire));
+        return static_cast<std::uint32_t>(top);
+    }
+
+    bool try_take(std::uint32_t index) {
+        bool idle = true;
+        return slots[index]->idle.compare_exchange_strong(idle, false);
+    }
+
+    void release(std::uint32_t index) {
+        auto& slot = *slots[index];
+        slot.idle.store(true);
+        if(!slot.listed.exchange(true)) push_free(index);
+        counters.in_use.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+public:
+
+    //
+    // Exclusive access to one state of the pool until the lease is destroyed.
+    //
+    class lease {
+        friend class state_pool;
+
+        state_pool* pool { nullptr };
+        std::uint32_t index { none };
+
+        lease(state_pool* pool, std::uint32_t index):
+        pool(pool), index(index) {}
+
+    public:
+        lease() = default;
+        lease(const lease&) = delete;
+        lease& operator=(const lease&) = delete;
+        lease(lease&& rhs):
+        pool(rhs.pool), index(rhs.index) {
+            rhs.pool = nullptr;
+        }
+        lease& operator=(lease&& rhs) {
+            std::swap(pool, rhs.pool);
+            std::swap(index, rhs.index);
+            return *this;
+        }
+        ~lease() {
+            if(pool) pool->release(index);
+        }
+
+        inline explicit operator bool() const {
+            return pool != nullptr;
+        }
+        inline elsa::state& operator*() const {
+            return pool->slots[index]->state;
+        }
+        inline elsa::state* operator->() const {
+            return &pool->slots[index]->state;
+        }
+    };
+
+    //
+    // Create @size states, opening the standard libraries if requested and
+    // running @init in each of them.
+    //
+    state_pool(std::size_t size, bool open_libs = true, const std::string& init = {},
+        const std::function<void(elsa::state&)>& setup = {}):
+    slots() {
+        if(size == 0 || size >= none) throw std::runtime_error("Invalid state pool size");
+        slots.reserve(size);
+        for(std::size_t i = 0; i < size; ++i) {
+            slots.emplace_back(new slot(open_libs));
+            if(!init.empty()) slots.back()->state(init);
+            if(setup) setup(slots.back()->state);
+        }
+        for(std::size_t i = size; i > 0; --i) {
+            slots[i - 1]->listed.store(true, std::memory_order_relaxed);
+            push_free(static_cast<std::uint32_t>(i - 1));
+        }
+    }
+
+    state_pool(const state_pool&) = delete;
+    state_pool& operator=(const state_pool&) = delete;
+
+    //
+    // Lease an idle state, preferring the one this thread used last.
+    // Returns an empty lease if all states are in use.
+    //
+    lease try_acquire() {
+        auto& affinity = thread_affinity();
+        if(affinity.pool == this && affinity.index < slots.size() && try_take(affinity.index)) {
+            counters.affinity_hits.fetch_add(1, std::memory_order_relaxed);
+            return take(affinity.index);
+        }
+        for(auto index = pop_free(); index != none; index = pop_free()) {
+            slots[index]->listed.store(false);
+            // entries taken through thread affinity stay in the list and are skipped here
+            if(try_take(index)) {
+                counters.free_list_hits.fetch_add(1, std::memory_order_relaxed);
+                affinity = { this, index };
+                return take(index);
+            }
+        }
+        return {};
+    }
+    //
+    // Lease an idle state, yielding until one becomes available.
+    //
+    lease acquire() {
+        auto lease = try_acquire();
+        if(lease) return lease;
+        counters.waits.fetch_add(1, std::memory_order_relaxed);
+        while(!(lease = try_acquire())) std::this_thread::yield();
+        return lease;
+    }
+
+    inline std::size_t size() const {
+        return slots.size();
+    }
+    pool_stats stats() const {
+        pool_stats stats;
+        stats.size = slots.size();
+        stats.in_use = counters.in_use.load(std::memory_order_relaxed);
+        stats.acquisitions = counters.acquisitions.load(std::memory_order_relaxed);
+        stats.affinity_hits = counters.affinity_hits.load(std::memory_order_relaxed);
+        stats.free_list_hits = counters.free_list_hits.load(std::memory_order_relaxed);
+        stats.waits = counters.waits.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+
+    lease take(std::uint32_t index) {
+        counters.acquisitions.fetch_add(1, std::memory_order_relaxed);
+        counters.in_use.fetch_add(1, std::memory_order_relaxed);
+        return { this, index };
+    }
+
+};
+
+}
@@ -0,0 +1,171 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  StaticPath.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+#define ELSA_HAS_STATIC_PATHS
+
+#include <array>
+#include <string_view>
+
+
+
+namespace elsa {
+
+//
+// String literal usable as a template argument: elsa::path<"config", "limits">.
+//
+template<std::size_t N>
+struct fixed_string {
+    char value[N] {};
+
+    constexpr fixed_string(const char (&string)[N]) {
+        for(std::size_t i = 0; i < N; ++i) value[i] = string[i];
+    }
+    constexpr std::string_view view() const {
+        return { value, N - 1 };
+    }
+};
+
+namespace utility {
+
+template<fixed_string... Segments>
+struct path_segments {
+    static constexpr std::array<std::string_view, sizeof...(Segments)> value { Segments.view()... };
+};
+
+// segments of a path separated by dots, split at compile time
+template<fixed_string Path>
+struct dotted_segments {
+    static constexpr std::size_t count() {
+        std::size_t count = 1;
+        for(char c: Path.view()) count += c == '.';
+        return count;
+    }
+    static constexpr std::array<std::string_view, count()> split() {
+        std::array<std::string_view, count()> segments {};
+        const auto path = Path.view();
+        std::size_t begin = 0, index = 0;
+        for(std::size_t i = 0; i <= path.size(); ++i) {
+            if(i < path.size() && path[i] != '.') continue;
+            segments[index++] = path.substr(begin, i - begin);
+            begin = i + 1;
+        }
+        return segments;
+    }
+    static constexpr auto value { split() };
+};
+
+// push the field @key of the table on top, or nil if it is not a table
+inline bool path_step(lua_State* state, std::string_view key) {
+    if(!lua_istable(state, -1)) {
+        lua_pushnil(state);
+        return false;
+    }
+    lua_pushlstring(state, key.data(), key.size());
+    lua_rawget(state, -2);
+    return true;
+}
+
+}
+
+//
+// Selector for a path known at compile time. It refers to the state without
+// holding a reference and stores nothing but the lua_State*, traversal is an
+// unrolled sequence of lua_pushlstring and lua_rawget.
+// A static selector must not outlive its state.
+//
+template<typename Segments>
+class static_selector {
+    static constexpr auto& segments { Segments::value };
+    static constexpr std::size_t depth { segments.size() };
+
+    lua_State* state;
+
+    template<std::size_t... I>
+    void traverse(std::index_sequence<I...>) const {
+        static_cast<void>((utility::path_step(state, segments[I]) && ...));
+    }
+
+public:
+
+    explicit static_selector(lua_State* state):
+    state(state) {}
+
+    // push the selected value, or nil if the path does not exist
+    void push() const {
+        const int top = lua_gettop(state);
+        utility::check_stack(state, static_cast<int>(depth) + 2);
+        lua_pushglobaltable(state);
+        traverse(std::make_index_sequence<depth>());
+        lua_replace(state, top + 1);
+        lua_settop(state, top + 1);
+    }
+
+    template<typename T>
+    T get() const {
+        utility::stack_guard guard {state};
+        push();
+        return utility::get<T>(state);
+    }
+    template<typename T>
+    explicit operator T() const {
+        return get<T>();
+    }
+
+    // assign @value to the selected field, the parent table must exist
+    template<typename T>
+    void set(T&& value) const {
+        utility::stack_guard guard {state};
+        utility::check_stack(state, static_cast<int>(depth) + 3);
+        lua_pushglobaltable(state);
+        traverse(std::make_index_sequence<depth - 1>());
+        if(!lua_istable(state, -1)) throw std::runtime_error("Could not assign: " + std::string(segments[depth - 1]) + " has no parent table");
+        lua_pushlstring(state, segments[depth - 1].data(), segments[depth - 1].size());
+        utility::push(state, std::forward<T>(value));
+        lua_rawset(state, -3);
+        utility::invalidate_generation(state);
+    }
+
+    template<typename... Ret, typename... Arg>
+    auto call(Arg&&... args) const {
+        utility::stack_guard guard {state};
+        push();
+        utility::push(state, std::forward<Arg>(args)...);
+        if(lua_pcall(state, utility::arity<Arg...>::value, utility::arity<Ret...>::value, 0)) {
+            std::string error = lua_tostring(state, -1);
+            throw std::runtime_error("Could not call: " + error);
+        }
+        return utility::get<Ret...>(state);
+    }
+    template<typename... Ret, typename... Arg>
+    auto try_call(Arg&&... args) const {
+        using output = decltype(utility::make_result<Ret...>(state));
+        utility::stack_guard guard {state};
+        push();
+        utility::push(state, std::forward<Arg>(args)...);
+        const int status = lua_pcall(state, utility::arity<Arg...>::value, utility::arity<Ret...>::value, 0);
+        if(status != 0) return output { elsa::error { state, static_cast<call_status>(status) } };
+        return utility::make_result<Ret...>(state);
+    }
+};
+
+//
+// Compile-time path given as separate segments:
+//
+//     elsa::path<"config", "limits", "max"> { state }.get<int>();
+//
+template<fixed_string... Segments>
+using path = static_selector<utility::path_segments<Segments...>>;
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  TableFields.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <tuple>
+#include <type_traits>
+
+
+
+namespace elsa {
+namespace utility {
+
+template<typename T>
+struct field_keys {};
+
+template<typename T>
+constexpr int field_count { static_cast<int>(std::tuple_size<std::decay_t<decltype(table_fields<T>::members)>>::value) };
+
+//
+// Push the array of the field names of @T. The names are interned once per state
+// and held in the registry, so converting a value reads its keys with lua_rawgeti
+// instead of hashing every name again.
+//
+template<typename T>
+inline void push_field_keys(lua_State* state) {
+    lua_pushlightuserdata(state, (void*)&registry_key<field_keys<T>>::key);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    if(!lua_isnil(state, -1)) return;
+    lua_pop(state, 1);
+    lua_createtable(state, field_count<T>, 0);
+    int index = 0;
+    std::apply([&](const auto&... fields) {
+        ((lua_pushstring(state, fields.name), lua_rawseti(state, -2, ++index)), ...);
+    }, table_fields<T>::members);
+    lua_pushlightuserdata(state, (void*)&registry_key<field_keys<T>>::key);
+    lua_pushvalue(state, -2);
+    lua_rawset(state, LUA_REGISTRYINDEX);
+}
+
+// write the fields of @value into the table at @table
+template<typename T>
+inline void set_fields(lua_State* state, int table, const T& value) {
+    table = absolute_index(state, table);
+    check_stack(state, 4);
+    push_field_keys<T>(state);
+    int index = 0;
+    std::apply([&](const auto&... fields) {
+        ((lua_rawgeti(state, -1, ++index), push(state, value.*(fields.member)), lua_rawset(state, table)), ...);
+    }, table_fields<T>::members);
+    lua_pop(state, 1);
+}
+
+template<typename T, typename>
+inline void push(lua_State* state, const T& value) {
+    check_stack(state, 1);
+    lua_createtable(state, 0, field_count<T>);
+    set_fields(state, -1, value);
+}
+
+namespace detail {
+    //
+    // Described aggregates are read field by field, missing fields keep their
+    // default value. Values that are not tables yield a default constructed value.
+    //
+    template<typename T>
+    struct getter<T, std::enable_if_t<has_fields<T>::value>> {
+        static T get(lua_State* state, int index) {
+            T value {};
+            if(!lua_istable(state, index)) return value;
+            index = absolute_index(state, index);
+            check_stack(state, 3);
+            push_field_keys<T>(state);
+            int key = 0;
+            std::apply([&](const auto&... fields) {
+                ((lua_rawgeti(state, -1, ++key), lua_rawget(state, index), read_field(state, value.*(fields.member)), lua_pop(state, 1)), ...);
+            }, table_fields<T>::members);
+            lua_pop(state, 1);
+            return value;
+        }
+        template<typename M>
+        static void read_field(lua_State* state, M& member) {
+            if(!lua_isnil(state, -1)) member = detail::get<M>(state, -1);
+        }
+    };
+}
+
+}
+}
@@ -0,0 +1,192 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  TableRange.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <iterator>
+#include <utility>
+
+
+
+namespace elsa {
+namespace utility {
+
+struct range_end {};
+
+//
+// Base of the table ranges. The table stays on the stack for the lifetime of the
+// range and the stack is restored when it is destroyed, also when leaving a loop early.
+// The table must not be modified while iterating and the range must not outlive the
+// stack frame it was created in.
+//
+class table_range {
+protected:
+    lua_State* state;
+    int top;
+
+    // the table to iterate is on top of the stack
+    explicit table_range(lua_State* state):
+    state(state), top(lua_gettop(state) - 1) {}
+
+public:
+
+    table_range(table_range&& rhs):
+    state(rhs.state), top(rhs.top) {
+        rhs.state = nullptr;
+    }
+    table_range(const table_range&) = delete;
+    table_range& operator=(const table_range&) = delete;
+    ~table_range() {
+        if(state) lua_settop(state, top);
+    }
+};
+
+//
+// Range over all pairs of a table through lua_next, converting keys and values
+// to @K and @V. The key of the current pair is the only value kept on the stack.
+//
+template<typename K, typename V>
+class pairs_range: public table_range {
+public:
+
+    class iterator {
+        lua_State* state { nullptr };
+        int table { 0 };
+        std::pair<K, V> current {};
+
+        void advance() {
+            if(!lua_next(state, table)) {
+                state = nullptr;
+                return;
+            }
+            // read a copy of the key, converting it in place would confuse lua_next
+            lua_pushvalue(state, -2);
+            current.first = detail::get<K>(state, -1);
+            current.second = detail::get<V>(state, -2);
+            lua_pop(state, 2);
+        }
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<K, V>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        iterator() = default;
+        iterator(lua_State* state, int table):
+        state(state), table(table) {
+            lua_settop(state, table);
+            lua_pushnil(state);
+            advance();
+        }
+
+        inline reference operator*() const {
+            return current;
+        }
+        inline pointer operator->() const {
+            return &current;
+        }
+        iterator& operator++() {
+            advance();
+            return *this;
+        }
+        inline bool operator==(range_end) const {
+            return state == nullptr;
+        }
+        inline bool operator!=(range_end) const {
+            return state != nullptr;
+        }
+    };
+
+    explicit pairs_range(lua_State* state):
+    table_range(state) {}
+
+    iterator begin() {
+        if(!lua_istable(state, top + 1)) return {};
+        check_stack(state, 4);
+        return { state, top + 1 };
+    }
+    inline range_end end() const {
+        return {};
+    }
+};
+
+//
+// Range over the values at 1, 2, ... of a table up to the first nil, read with
+// lua_rawgeti and converted to @V. Elements are pairs of the index and the value.
+//
+template<typename V>
+class ipairs_range: public table_range {
+public:
+
+    class iterator {
+        lua_State* state { nullptr };
+        int table { 0 };
+        std::pair<std::size_t, V> current {};
+
+        void advance() {
+            lua_rawgeti(state, table, static_cast<int>(current.first + 1));
+            if(lua_isnil(state, -1)) {
+                lua_pop(state, 1);
+                state = nullptr;
+                return;
+            }
+            ++current.first;
+            current.second = detail::get<V>(state, -1);
+            lua_pop(state, 1);
+        }
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<std::size_t, V>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        iterator() = default;
+        iterator(lua_State* state, int table):
+        state(state), table(table) {
+            advance();
+        }
+
+        inline reference operator*() const {
+            return current;
+        }
+        inline pointer operator->() const {
+            return &current;
+        }
+        iterator& operator++() {
+            advance();
+            return *this;
+        }
+        inline bool operator==(range_end) const {
+            return state == nullptr;
+        }
+        inline bool operator!=(range_end) const {
+            return state != nullptr;
+        }
+    };
+
+    explicit ipairs_range(lua_State* state):
+    table_range(state) {}
+
+    iterator begin() {
+        if(!lua_istable(state, top + 1)) return {};
+        check_stack(state, 2);
+        return { state, top + 1 };
+    }
+    inline range_end end() const {
+        return {};
+    }
+};
+
+}
+}
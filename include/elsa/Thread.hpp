@@ -0,0 +1,290 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  Thread.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+
+
+namespace elsa {
+
+enum class thread_status {
+    suspended,
+    finished,
+    error
+};
+
+//
+// Lua coroutine running a function on its own Lua stack.
+// The coroutine is anchored in the registry for the lifetime of the thread.
+//
+class thread {
+    base_state state;
+    lua_State* lthread { nullptr };
+    int ref { LUA_NOREF };
+    int results { 0 };
+    thread_status status_ { thread_status::suspended };
+
+public:
+
+    // @function must select a value of @state, it is moved to the new Lua stack
+    thread(base_state state, const selector& function):
+    state(state) {
+        if((lua_State*)function.state != (lua_State*)state) throw std::runtime_error("Could not create thread: the function belongs to another state");
+        utility::check_stack(state, 2);
+        lthread = lua_newthread(state);
+        ref = luaL_ref(state, LUA_REGISTRYINDEX);
+        function.push();
+        lua_xmove(state, lthread, 1);
+    }
+    thread(thread&& rhs):
+    state(std::move(rhs.state)), lthread(rhs.lthread), ref(rhs.ref), results(rhs.results),
+    status_(rhs.status_) {
+        rhs.lthread = nullptr;
+        rhs.ref = LUA_NOREF;
+    }
+    thread& operator=(thread&& rhs) {
+        std::swap(state, rhs.state);
+        std::swap(lthread, rhs.lthread);
+        std::swap(ref, rhs.ref);
+        std::swap(results, rhs.results);
+        std::swap(status_, rhs.status_);
+        return *this;
+    }
+    thread(const thread&) = delete;
+    thread& operator=(const thread&) = delete;
+
+    ~thread() {
+        if(lthread) luaL_unref(state, LUA_REGISTRYINDEX, ref);
+    }
+
+    //
+    // Resume the coroutine, passing @args to the function on the first resume
+    // and as the results of coroutine.yield afterwards.
+    //
+    template<typename... Arg>
+    thread_status resume(Arg&&... args) {
+        if(status_ != thread_status::suspended) throw std::runtime_error("Could not resume a dead thread");
+        lua_pop(lthread, results);
+        utility::check_stack(lthread, static_cast<int>(utility::arity<Arg...>::value));
+        utility::push(lthread, std::forward<Arg>(args)...);
+        const int arguments = static_cast<int>(utility::arity<Arg...>::value);
+#if LUA_VERSION_NUM >= 504
+        const int status = lua_resume(lthread, state, arguments, &results);
+#elif LUA_VERSION_NUM >= 502
+        const int status = lua_resume(lthread, state, arguments);
+        results = lua_gettop(lthread);
+#else
+        const int status = lua_resume(lthread, arguments);
+        results = lua_gettop(lthread);
+#endif
+        if(status == LUA_YIELD) status_ = thread_status::suspended;
+        else if(status == 0) status_ = thread_status::finished;
+        else {
+            status_ = thread_status::error;
+            results = 1;
+        }
+        return status_;
+    }
+
+    //
+    // Read the values passed to coroutine.yield or returned by the function.
+    //
+    template<typename... T>
+    inline auto get() const {
+        return utility::get<T...>(lthread);
+    }
+
+    inline thread_status status() const {
+        return status_;
+    }
+    inline bool resumable() const {
+        return status_ == thread_status::suspended;
+    }
+    inline int result_count() const {
+        return results;
+    }
+    std::string error() const {
+        if(status_ != thread_status::error) return {};
+        return utility::get<std::string>(lthread);
+    }
+
+    inline operator lua_State*() const {
+        return lthread;
+    }
+
+};
+
+
+namespace utility {
+// notified by the scheduler after it resumed a thread on behalf of a waiter
+struct thread_waiter {
+    virtual ~thread_waiter() = default;
+    virtual void resumed(elsa::thread& thread) = 0;
+};
+}
+
+//
+// Resumes ready threads in batches. Spawned threads are owned by the scheduler and
+// resumed until they finish, awaited threads are resumed once per co_await.
+//
+class scheduler {
+    struct entry {
+        elsa::thread* thread;
+        utility::thread_waiter* waiter;
+        // spawned threads are owned by their entry and released with it when they finish
+        std::unique_ptr<elsa::thread> owned;
+    };
+    std::deque<entry> ready {};
+    std::size_t errors { 0 };
+
+public:
+
+    void spawn(elsa::thread thread) {
+        std::unique_ptr<elsa::thread> owned { new elsa::thread(std::move(thread)) };
+        auto pointer = owned.get();
+        ready.push_back({ pointer, nullptr, std::move(owned) });
+    }
+    void enqueue(elsa::thread& thread, utility::thread_waiter* waiter) {
+        ready.push_back({ &thread, waiter, nullptr });
+    }
+
+    //
+    // Resume up to @max ready threads. Returns the number of threads resumed.
+    //
+    std::size_t run_batch(std::size_t max = static_cast<std::size_t>(-1)) {
+        std::size_t resumed = 0;
+        for(std::size_t count = ready.size(); count > 0 && resumed < max; --count, ++resumed) {
+            entry current = std::move(ready.front());
+            ready.pop_front();
+            auto& thread = *current.thread;
+            if(thread.resumable()) thread.resume();
+            if(current.waiter) {
+                current.waiter->resumed(thread);
+                continue;
+            }
+            if(thread.status() == thread_status::error) ++errors;
+            if(thread.resumable()) ready.push_back(std::move(current));
+        }
+        return resumed;
+    }
+    // resume threads until none are ready
+    void run() {
+        while(!ready.empty()) run_batch();
+    }
+
+    inline std::size_t size() const {
+        return ready.size();
+    }
+    inline std::size_t error_count() const {
+        return errors;
+    }
+
+};
+
+
+#if defined(__cpp_impl_coroutine)
+
+//
+// Awaitable resuming a Lua thread through a scheduler. The C++ coroutine continues
+// with the values the Lua coroutine yielded or returned.
+//
+template<typename... Ret>
+class thread_awaitable: utility::thread_waiter {
+    using result = decltype(std::declval<elsa::thread&>().get<Ret...>());
+    using value = std::conditional_t<std::is_void<result>::value, bool, result>;
+
+    scheduler& sched;
+    elsa::thread& thread;
+    std::coroutine_handle<> handle {};
+    std::optional<value> values {};
+    std::string error {};
+
+    void resumed(elsa::thread& thread) override {
+        if(thread.status() == thread_status::error) error = thread.error();
+        else if constexpr(std::is_void<result>::value) values = true;
+        else values = thread.get<Ret...>();
+        handle.resume();
+    }
+
+public:
+
+    thread_awaitable(scheduler& sched, elsa::thread& thread):
+    sched(sched), thread(thread) {}
+
+    bool await_ready() const {
+        return !thread.resumable();
+    }
+    void await_suspend(std::coroutine_handle<> handle) {
+        this->handle = handle;
+        sched.enqueue(thread, this);
+    }
+    result await_resume() {
+        if(!values) throw std::runtime_error("Could not resume thread: " +
+            (error.empty() ? std::string("thread is dead") : error));
+        if constexpr(!std::is_void<result>::value) return std::move(*values);
+    }
+};
+
+template<typename... Ret>
+inline thread_awaitable<Ret...> next(scheduler& sched, thread& thread) {
+    return { sched, thread };
+}
+
+//
+// Minimal eagerly started coroutine type for fire-and-forget tasks awaiting threads.
+// Exceptions escaping the coroutine, such as errors raised by an awaited Lua thread,
+// end it and are passed to the error handler if one is set, otherwise they are
+// written to std::cerr. The failed thread keeps its status and error message.
+//
+struct detached {
+    using handler = std::function<void(std::exception_ptr)>;
+
+    // handler for all detached coroutines, set it before starting any of them
+    static handler& error_handler() {
+        static handler value {};
+        return value;
+    }
+
+    struct promise_type {
+        detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {
+            if(auto& handler = error_handler()) {
+                handler(std::current_exception());
+                return;
+            }
+            try {
+                throw;
+            }
+            catch(const std::exception& e) {
+                std::cerr << "Unhandled exception in detached coroutine: " << e.what() << std::endl;
+            }
+            catch(...) {
+                std::cerr << "Unhandled exception in detached coroutine" << std::endl;
+            }
+        }
+    };
+};
+
+#endif
+
+}
@@ -0,0 +1,345 @@
+//
+//  Elsa Lua Interface
+//
+//
+//  Copyright (c) Elsa contributors, 2026
+//
+//  Usertype.hpp
+//  Created 2026-10-18
+//
+
+#pragma once
+
+
+
+namespace elsa {
+namespace utility {
+
+//
+// Userdata layout of usertypes. Values are constructed in place after the header
+// and destroyed by __gc, pointers are referenced without taking ownership.
+//
+
+template<typename T>
+struct usertype_box {
+    T* object;
+    bool owned;
+};
+template<typename T>
+struct usertype_value {
+    usertype_box<T> header;
+    alignas(T) unsigned char storage[sizeof(T)];
+};
+
+template<typename T>
+struct usertype_key {
+    static constexpr char key {};
+};
+
+namespace detail {
+    template<typename T>
+    int usertype_gc(lua_State* state) {
+        auto box = static_cast<usertype_box<T>*>(lua_touserdata(state, 1));
+        if(box && box->owned) box->object->~T();
+        return 0;
+    }
+    // look up methods first, then call the getter of a field
+    inline int usertype_index(lua_State* state) {
+        lua_pushvalue(state, 2);
+        lua_rawget(state, lua_upvalueindex(1));
+        if(!lua_isnil(state, -1)) return 1;
+        lua_pop(state, 1);
+        lua_pushvalue(state, 2);
+        lua_rawget(state, lua_upvalueindex(2));
+        if(lua_isnil(state, -1)) return 1;
+        lua_pushvalue(state, 1);
+        lua_call(state, 1, 1);
+        return 1;
+    }
+    inline int usertype_newindex(lua_State* state) {
+        lua_pushvalue(state, 2);
+        lua_rawget(state, lua_upvalueindex(1));
+        if(lua_isnil(state, -1)) {
+            // keys that are neither strings nor numbers have no string to report
+            return luaL_error(state, "cannot assign to field '%s'", lua_isstring(state, 2) ? lua_tostring(state, 2) : lua_typename(state, lua_type(state, 2)));
+        }
+        lua_pushvalue(state, 1);
+        lua_pushvalue(state, 3);
+        lua_call(state, 2, 0);
+        return 0;
+    }
+}
+
+// indices of the dispatch tables stored in the metatable
+enum usertype_table { methods = 1, getters = 2, setters = 3 };
+
+//
+// Push the metatable of T. It is created once per state and cached in the registry,
+// methods and fields dispatch through tables captured by __index and __newindex.
+//
+template<typename T>
+inline void push_usertype_metatable(lua_State* state) {
+    lua_pushlightuserdata(state, (void*)&usertype_key<T>::key);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    if(lua_istable(state, -1)) return;
+    lua_pop(state, 1);
+    check_stack(state, 6);
+    lua_createtable(state, 3, 4);
+    const int metatable = lua_gettop(state);
+    lua_newtable(state);
+    lua_newtable(state);
+    lua_newtable(state);
+    // metatable[methods], metatable[getters], metatable[setters]
+    for(int table = usertype_table::methods; table <= usertype_table::setters; ++table) {
+        lua_pushvalue(state, metatable + table);
+        lua_rawseti(state, metatable, table);
+    }
+    lua_pushliteral(state, "__newindex");
+    lua_insert(state, -2);
+    lua_pushcclosure(state, detail::usertype_newindex, 1);
+    lua_rawset(state, metatable);
+    lua_pushliteral(state, "__index");
+    lua_insert(state, -3);
+    lua_pushcclosure(state, detail::usertype_index, 2);
+    lua_rawset(state, metatable);
+    lua_pushliteral(state, "__gc");
+    lua_pushcfunction(state, detail::usertype_gc<T>);
+    lua_rawset(state, metatable);
+    lua_pushlightuserdata(state, (void*)&usertype_key<T>::key);
+    lua_pushvalue(state, metatable);
+    lua_rawset(state, LUA_REGISTRYINDEX);
+}
+
+//
+// Construct a T in place in a new userdata.
+//
+template<typename T, typename... A>
+inline T& emplace_usertype(lua_State* state, A&&... args) {
+    static_assert(alignof(T) <= alignof(userdata_alignment), "Usertype is overaligned");
+    check_stack(state, 2);
+    auto value = static_cast<usertype_value<T>*>(lua_newuserdata(state, sizeof(usertype_value<T>)));
+    value->header = { nullptr, false };
+    auto object = new(value->storage) T(std::forward<A>(args)...);
+    value->header = { object, true };
+    push_usertype_metatable<T>(state);
+    lua_setmetatable(state, -2);
+    return *object;
+}
+
+//
+// Return the object of the usertype T at @index or nullptr if the value is not a T.
+//
+template<typename T>
+inline T* to_usertype(lua_State* state, int index) {
+    auto box = static_cast<usertype_box<T>*>(lua_touserdata(state, index));
+    if(!box || !lua_getmetatable(state, index)) return nullptr;
+    push_usertype_metatable<T>(state);
+    const bool same = lua_rawequal(state, -1, -2);
+    lua_pop(state, 2);
+    return same ? box->object : nullptr;
+}
+
+
+template<typename T, typename>
+inline void push(lua_State* state, T&& value) {
+    emplace_usertype<std::decay_t<T>>(state, std::forward<T>(value));
+}
+template<typename T, typename>
+inline void push(lua_State* state, T* value) {
+    if(!value) {
+        lua_pushnil(state);
+        return;
+    }
+    check_stack(state, 2);
+    auto box = static_cast<usertype_box<T>*>(lua_newuserdata(state, sizeof(usertype_box<T>)));
+    *box = { value, false };
+    push_usertype_metatable<T>(state);
+    lua_setmetatable(state, -2);
+}
+
+namespace detail {
+    template<typename T>
+    inline T& get_usertype(lua_State* state, int index) {
+        if(auto object = to_usertype<T>(state, index)) return *object;
+        throw std::runtime_error("Expected a usertype value at index " + std::to_string(index));
+    }
+
+    template<typename T>
+    struct getter<T, std::enable_if_t<is_usertype<T>::value>> {
+        static T get(lua_State* state, int index) {
+            return get_usertype<T>(state, index);
+        }
+    };
+    template<typename T>
+    struct getter<T&, std::enable_if_t<is_usertype<std::remove_cv_t<T>>::value>> {
+        static T& get(lua_State* state, int index) {
+            return get_usertype<std::remove_cv_t<T>>(state, index);
+        }
+    };
+    template<typename T>
+    struct getter<T*, std::enable_if_t<is_usertype<std::remove_cv_t<T>>::value>> {
+        static T* get(lua_State* state, int index) {
+            return to_usertype<std::remove_cv_t<T>>(state, index);
+        }
+    };
+}
+
+// usertype arguments of functions bind directly to the object in the userdata
+template<typename A>
+struct argument<A&, std::enable_if_t<is_usertype<std::remove_cv_t<A>>::value>> {
+    using type = A&;
+};
+
+}
+
+
+//
+// Describe how a C++ class is exposed to Lua:
+//
+//     elsa::usertype<vec2> { state, "vec2" }
+//         .constructor<float, float>()
+//         .method("length", &vec2::length)
+//         .field("x", &vec2::x);
+//
+// The type has to be opted in through elsa::is_usertype. Instances are pushed by
+// value (constructed in place in the userdata) or by pointer.
+//
+template<typename T>
+class usertype {
+    static_assert(utility::is_usertype<T>::value, "Opt the type in with a specialization of elsa::is_usertype");
+
+    lua_State* state;
+    std::string name;
+
+    usertype& set(int table, const std::string& key) {
+        // expects the value on top of the stack
+        utility::push_usertype_metatable<T>(state);
+        if(table) {
+            lua_rawgeti(state, -1, table);
+            lua_remove(state, -2);
+        }
+        utility::push(state, key);
+        lua_pushvalue(state, -3);
+        lua_rawset(state, -3);
+        lua_pop(state, 2);
+        return *this;
+    }
+    template<typename F>
+    usertype& set_function(int table, const std::string& key, F&& function) {
+        utility::stack_guard guard {state};
+        utility::push_function(state, std::forward<F>(function));
+        return set(table, key);
+    }
+
+    template<typename... A, std::size_t... N>
+    static void construct(lua_State* state, std::index_sequence<N...>) {
+        utility::emplace_usertype<T>(state, utility::detail::get<utility::argument_t<A>>(state, static_cast<int>(N) + 1)...);
+    }
+    template<typename... A>
+    static int constructor_function(lua_State* state) {
+        return utility::protect(state, [&]() {
+            construct<A...>(state, std::index_sequence_for<A...>());
+            return 1;
+        });
+    }
+
+public:
+
+    //
+    // Register T in @state. If @name is given, a global table of that name holds
+    // the constructors and static functions.
+    //
+    usertype(lua_State* state, std::string name = {}):
+    state(state), name(std::move(name)) {
+        utility::stack_guard guard {state};
+        utility::push_usertype_metatable<T>(state);
+        if(!this->name.empty()) {
+            lua_pushliteral(state, "__name");
+            utility::push(state, this->name);
+            lua_rawset(state, -3);
+            lua_pushglobaltable(state);
+            utility::push(state, this->name);
+            lua_rawget(state, -2);
+            if(!lua_istable(state, -1)) {
+                lua_pop(state, 1);
+                utility::push(state, this->name);
+                lua_newtable(state);
+                lua_rawset(state, -3);
+            }
+        }
+    }
+
+    // add a constructor taking @A to the class table
+    template<typename... A>
+    usertype& constructor(const std::string& key = "new") {
+        if(name.empty()) throw std::runtime_error("Constructors require a named usertype");
+        utility::stack_guard guard {state};
+        lua_pushcfunction(state, constructor_function<A...>);
+        return static_function(key);
+    }
+
+    template<typename F>
+    usertype& static_function(const std::string& key, F&& function) {
+        utility::stack_guard guard {state};
+        utility::push_function(state, std::forward<F>(function));
+        return static_function(key);
+    }
+
+    template<typename R, typename... A>
+    usertype& method(const std::string& key, R (T::*method)(A...)) {
+        return set_function(utility::usertype_table::methods, key, [method](T& self, A... args) -> R {
+            return (self.*method)(std::forward<A>(args)...);
+        });
+    }
+    template<typename R, typename... A>
+    usertype& method(const std::string& key, R (T::*method)(A...) const) {
+        return set_function(utility::usertype_table::methods, key, [method](const T& self, A... args) -> R {
+            return (self.*method)(std::forward<A>(args)...);
+        });
+    }
+    // functions taking the object as their first argument
+    template<typename F, typename = std::enable_if_t<utility::is_function<F>::value>>
+    usertype& method(const std::string& key, F&& function) {
+        return set_function(utility::usertype_table::methods, key, std::forward<F>(function));
+    }
+
+    template<typename M>
+    usertype& field(const std::string& key, M T::* member, bool writable = true) {
+        set_function(utility::usertype_table::getters, key, [member](const T& self) -> M {
+            return self.*member;
+        });
+        if(writable) set_function(utility::usertype_table::setters, key, [member](T& self, M value) {
+            self.*member = std::move(value);
+        });
+        return *this;
+    }
+
+    // set a metamethod such as __add, __eq or __tostring
+    template<typename F, typename = std::enable_if_t<utility::is_function<F>::value>>
+    usertype& meta(const std::string& key, F&& function) {
+        return set_function(0, key, std::forward<F>(function));
+    }
+    template<typename R, typename... A>
+    usertype& meta(const std::string& key, R (T::*method)(A...) const) {
+        return set_function(0, key, [method](const T& self, A... args) -> R {
+            return (self.*method)(std::forward<A>(args)...);
+        });
+    }
+
+private:
+
+    usertype& static_function(const std::string& key) {
+        // expects the function on top of the stack
+        lua_pushglobaltable(state);
+        utility::push(state, name);
+        lua_rawget(state, -2);
+        utility::push(state, key);
+        lua_pushvalue(state, -4);
+        lua_rawset(state, -3);
+        lua_pop(state, 3);
+        return *this;
+    }
+
+};
+
+}
@@ -11,13 +11,20 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include <tuple>
 #include <sstream>
 #include <utility>
 #include <atomic>
 #include <vector>
+#include <array>
+#include <map>
+#include <unordered_map>
 #include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
 
 
 
@@ -29,18 +36,7 @@ struct stack_guard {
     explicit stack_guard(lua_State* state):
     state(state), stack_top(lua_gettop(state)) {}
     ~stack_guard() {
-#if defined(__cpp_lib_uncaught_exceptions)
-        if(!std::uncaught_exceptions())
-            lua_settop(state, stack_top);
-#else
-        if(!std::uncaught_exception())
-            lua_settop(state, stack_top);
-#endif
-        // TODO: remove this stupid test output ;)
-        else {
-            std::cout << "!unwinding! ";
-            lua_settop(state, 0);
-        }
+        lua_settop(state, stack_top);
     }
 private:
     lua_State* state;
@@ -52,6 +48,99 @@ private:
 };
 
 
+inline int absolute_index(lua_State* state, int index) {
+#if LUA_VERSION_NUM >= 502
+    return lua_absindex(state, index);
+#else
+    return (index < 0 && index > LUA_REGISTRYINDEX) ? lua_gettop(state) + index + 1 : index;
+#endif
+}
+
+inline std::size_t raw_length(lua_State* state, int index) {
+#if LUA_VERSION_NUM >= 502
+    return lua_rawlen(state, index);
+#else
+    return lua_objlen(state, index);
+#endif
+}
+
+inline void check_stack(lua_State* state, int size) {
+    if(!lua_checkstack(state, size)) throw std::runtime_error("Could not grow the Lua stack");
+}
+
+
+//
+// Per-state C++ objects stored as userdata in the registry.
+// The object is created on first access and destroyed when the Lua state is closed.
+//
+
+template<typename T>
+struct registry_key {
+    static constexpr char key {};
+};
+
+template<typename T>
+inline T* find_registry_object(lua_State* state) {
+    lua_pushlightuserdata(state, (void*)&registry_key<T>::key);
+    lua_rawget(state, LUA_REGISTRYINDEX);
+    auto object = static_cast<T*>(lua_touserdata(state, -1));
+    lua_pop(state, 1);
+    return object;
+}
+
+template<typename T>
+inline T& registry_object(lua_State* state) {
+    if(auto object = find_registry_object<T>(state)) return *object;
+    lua_pushlightuserdata(state, (void*)&registry_key<T>::key);
+    auto object = new(lua_newuserdata(state, sizeof(T))) T {};
+    if(!std::is_trivially_destructible<T>::value) {
+        lua_createtable(state, 0, 1);
+        lua_pushcfunction(state, [](lua_State* state) -> int {
+            static_cast<T*>(lua_touserdata(state, 1))->~T();
+            return 0;
+        });
+        lua_setfield(state, -2, "__gc");
+        lua_setmetatable(state, -2);
+    }
+    lua_rawset(state, LUA_REGISTRYINDEX);
+    return *object;
+}
+
+
+//
+// Counter that is incremented whenever code run through Elsa may have replaced
+// tables that bound selectors resolved their paths through.
+//
+
+struct state_generation {
+    unsigned int value { 0 };
+};
+
+inline const unsigned int* generation(lua_State* state) {
+    return &registry_object<state_generation>(state).value;
+}
+// states without bound selectors have no counter to increment
+inline void invalidate_generation(lua_State* state) {
+    if(auto generation = find_registry_object<state_generation>(state)) ++generation->value;
+}
+
+//
+// Invalidates the bound selectors when leaving a scope that ran a chunk through the
+// state, which may have replaced any table, also when it failed or threw.
+//
+struct generation_guard {
+    explicit generation_guard(lua_State* state):
+    state(state) {}
+    ~generation_guard() {
+        invalidate_generation(state);
+    }
+private:
+    lua_State* state;
+    generation_guard(const generation_guard&) = delete;
+    generation_guard& operator=(const generation_guard&) = delete;
+};
+
+
 template<bool... T>
     struct all;
 template <>
@@ -137,28 +226,146 @@ inline void push(lua_State* state, bool value) {
 inline void push(lua_State* state, const char* value) {
     lua_pushstring(state, value);
 }
-inline void push(lua_State* state, std::string value) {
-    lua_pushstring(state, value.c_str());
+inline void push(lua_State* state, const std::string& value) {
+    lua_pushlstring(state, value.data(), value.size());
+}
+inline void push(lua_State* state, std::string_view value) {
+    lua_pushlstring(state, value.data(), value.size());
 }
 
-template<typename... T>
-inline void push(lua_State* state, T&&... values) {
-    (push(state, std::forward(values)), ...);
 }
 
-template<typename... T, std::size_t... N>
-inline void push(lua_State* state, const std::tuple<T...>&& values, std::index_sequence<N...>) {
-    (push(state, std::get<N>(std::forward(values))), ...);
+//
+// Class types are pushed and read as usertypes only when opted in, see Usertype.hpp:
+//
+//     template<> struct elsa::is_usertype<vec2>: std::true_type {};
+//
+// Other class types without a dedicated conversion fail to compile.
+//
+template<typename T>
+struct is_usertype: std::false_type {};
+
+//
+// Aggregates described by a specialization of table_fields are converted to and
+// from tables field by field instead of being pushed as usertypes:
+//
+//     namespace elsa {
+//         template<> struct table_fields<entity> {
+//             static constexpr auto members = std::make_tuple(field { "x", &entity::x }, field { "hp", &entity::hp });
+//         };
+//     }
+//
+// See TableFields.hpp.
+//
+template<typename T>
+struct table_fields {};
+
+template<typename T, typename M>
+struct field {
+    const char* name;
+    M T::* member;
+
+    constexpr field(const char* name, M T::* member):
+    name(name), member(member) {}
+};
+
+namespace utility {
+
+template<typename T, typename = void>
+struct has_fields: std::false_type {};
+template<typename T>
+struct has_fields<T, std::void_t<decltype(table_fields<T>::members)>>: std::true_type {};
+
+template<typename T>
+struct is_usertype: std::integral_constant<bool, elsa::is_usertype<T>::value> {
+    static_assert(!elsa::is_usertype<T>::value || !has_fields<T>::value,
+        "A type cannot be both a usertype and described by table_fields");
+};
+
+template<typename T, typename = std::enable_if_t<is_usertype<std::decay_t<T>>::value>>
+inline void push(lua_State* state, T&& value);
+template<typename T, typename = std::enable_if_t<is_usertype<T>::value>>
+inline void push(lua_State* state, T* value);
+template<typename T, typename = std::enable_if_t<has_fields<T>::value>>
+inline void push(lua_State* state, const T& value);
+
+template<typename T, typename A>
+inline void push(lua_State* state, const std::vector<T, A>& values);
+template<typename T, std::size_t N>
+inline void push(lua_State* state, const std::array<T, N>& values);
+template<typename K, typename V, typename C, typename A>
+inline void push(lua_State* state, const std::map<K, V, C, A>& values);
+template<typename K, typename V, typename H, typename E, typename A>
+inline void push(lua_State* state, const std::unordered_map<K, V, H, E, A>& values);
+template<typename... T>
+inline void push(lua_State* state, const std::tuple<T...>& values);
+
+template<typename T0, typename T1, typename... T>
+inline void push(lua_State* state, T0&& value0, T1&& value1, T&&... values) {
+    push(state, std::forward<T0>(value0));
+    push(state, std::forward<T1>(value1));
+    (push(state, std::forward<T>(values)), ...);
 }
+
 template<typename... T>
-inline void push(lua_State* state, const std::tuple<T...>&& values) {
-   push(state, std::forward(values), std::make_index_sequence<sizeof...(T)>());
+inline void push(lua_State* state, const std::tuple<T...>& values) {
+    std::apply([&](const auto&... values) {
+        (push(state, values), ...);
+    }, values);
+}
+
+//
+// Containers are pushed as tables with their size preallocated.
+// Sequences fill the array part, maps the hash part.
+//
+
+namespace detail {
+    template<typename Iterator>
+    inline void push_sequence(lua_State* state, Iterator begin, const std::size_t size) {
+        check_stack(state, 2);
+        lua_createtable(state, static_cast<int>(size), 0);
+        for(int i = 1; i <= static_cast<int>(size); ++i, ++begin) {
+            push(state, *begin);
+            lua_rawseti(state, -2, i);
+        }
+    }
+    template<typename Map>
+    inline void push_map(lua_State* state, const Map& values) {
+        check_stack(state, 3);
+        lua_createtable(state, 0, static_cast<int>(values.size()));
+        for(const auto& value: values) {
+            push(state, value.first);
+            push(state, value.second);
+            lua_rawset(state, -3);
+        }
+    }
+}
+
+template<typename T, typename A>
+inline void push(lua_State* state, const std::vector<T, A>& values) {
+    detail::push_sequence(state, values.begin(), values.size());
+}
+template<typename T, std::size_t N>
+inline void push(lua_State* state, const std::array<T, N>& values) {
+    detail::push_sequence(state, values.begin(), N);
+}
+template<typename K, typename V, typename C, typename A>
+inline void push(lua_State* state, const std::map<K, V, C, A>& values) {
+    detail::push_map(state, values);
+}
+template<typename K, typename V, typename H, typename E, typename A>
+inline void push(lua_State* state, const std::unordered_map<K, V, H, E, A>& values) {
+    detail::push_map(state, values);
 }
 
 
 
 namespace detail {
-    template<typename T> inline T get(lua_State* state, int index);
+    template<typename T, typename = void> struct getter;
+    
+    template<typename T> inline T get(lua_State* state, int index) {
+        return getter<T>::get(state, index);
+    }
     
     template<> inline int get(lua_State* state, int index) {
         return static_cast<int>(lua_tointeger(state, index));
@@ -190,12 +397,84 @@ namespace detail {
         return static_cast<bool>(lua_toboolean(state, index));
     }
     template<> inline std::string get(lua_State* state, int index) {
-        return lua_tostring(state, index);
+        std::size_t length { 0 };
+        const char* value = lua_tolstring(state, index, &length);
+        return value ? std::string(value, length) : std::string();
+    }
+    // the returned view stays valid as long as the string is reachable from Lua,
+    // e.g. while it remains on the stack or is held in a registry slot
+    template<> inline std::string_view get(lua_State* state, int index) {
+        std::size_t length { 0 };
+        const char* value = lua_tolstring(state, index, &length);
+        return value ? std::string_view(value, length) : std::string_view();
     }
     template<> inline const char* get(lua_State* state, int index) {
         return lua_tostring(state, index);
     }
     
+    //
+    // Containers are read from tables, sequences from the array part 1..#t.
+    // Values that are not tables yield empty containers.
+    //
+    
+    template<typename Sequence>
+    struct sequence_getter {
+        static Sequence get(lua_State* state, int index) {
+            Sequence values;
+            if(!lua_istable(state, index)) return values;
+            index = absolute_index(state, index);
+            const int length = static_cast<int>(raw_length(state, index));
+            check_stack(state, 1);
+            values.reserve(length);
+            for(int i = 1; i <= length; ++i) {
+                lua_rawgeti(state, index, i);
+                values.push_back(detail::get<typename Sequence::value_type>(state, -1));
+                lua_pop(state, 1);
+            }
+            return values;
+        }
+    };
+    template<typename Map>
+    struct map_getter {
+        static Map get(lua_State* state, int index) {
+            Map values;
+            if(!lua_istable(state, index)) return values;
+            index = absolute_index(state, index);
+            check_stack(state, 3);
+            lua_pushnil(state);
+            while(lua_next(state, index)) {
+                // read a copy of the key, converting it in place would confuse lua_next
+                lua_pushvalue(state, -2);
+                auto key = detail::get<typename Map::key_type>(state, -1);
+                values.emplace(std::move(key), detail::get<typename Map::mapped_type>(state, -2));
+                lua_pop(state, 2);
+            }
+            return values;
+        }
+    };
+    
+    template<typename T, typename A>
+    struct getter<std::vector<T, A>>: sequence_getter<std::vector<T, A>> {};
+    template<typename T, std::size_t N>
+    struct getter<std::array<T, N>> {
+        static std::array<T, N> get(lua_State* state, int index) {
+            std::array<T, N> values {};
+            if(!lua_istable(state, index)) return values;
+            index = absolute_index(state, index);
+            check_stack(state, 1);
+            for(int i = 1; i <= static_cast<int>(N); ++i) {
+                lua_rawgeti(state, index, i);
+                values[i - 1] = detail::get<T>(state, -1);
+                lua_pop(state, 1);
+            }
+            return values;
+        }
+    };
+    template<typename K, typename V, typename C, typename A>
+    struct getter<std::map<K, V, C, A>>: map_getter<std::map<K, V, C, A>> {};
+    template<typename K, typename V, typename H, typename E, typename A>
+    struct getter<std::unordered_map<K, V, H, E, A>>: map_getter<std::unordered_map<K, V, H, E, A>> {};
+    
 }
 
 
@@ -210,8 +489,9 @@ struct stack_value {
         lua_pop(state, arg_arity);
         return ret;
     }
+    // braced initialization reads the values in order, function arguments have none
     static inline type get(lua_State* state, int& index) {
-        return std::make_tuple(stack_value<1, T>::get(state, index)...);
+        return type { stack_value<1, T>::get(state, index)... };
     }
 };
 template<typename... T>
@@ -13,6 +13,9 @@
 
 #include <utility>
 #include <vector>
+#include <thread>
+#include <filesystem>
+#include <fstream>
 
 
 bool test_(elsa::state& state) {
@@ -214,6 +217,776 @@ bool test_call_multiple_times(elsa::state& state) {
 }
 
 
+bool test_selector_bind(elsa::state& state) {
+    state("a = { b = { c = function(x) return x * 2; end; } }");
+    auto c = state["a"]["b"]["c"];
+    c.bind();
+    int x = c(2);
+    int y = c.call<int>(3);
+    return c.bound() && x == 4 && y == 6;
+}
+
+bool test_selector_bind_invalidate(elsa::state& state) {
+    state("a = { b = 5 }");
+    auto b = state["a"]["b"];
+    b.bind();
+    bool first = b == 5;
+    state("a = { b = 10 }");
+    bool second = b == 10;
+    b.unbind();
+    return first && second && !b.bound() && b == 10;
+}
+
+bool test_selector_bind_call(elsa::state& state) {
+    state("a = { b = 5 }; replace = function() a = { b = 10 }; end");
+    auto b = state["a"]["b"];
+    b.bind();
+    bool first = b == 5;
+    // a plain call keeps the binding, the path is not resolved again
+    state["replace"]();
+    bool cached = b == 5;
+    state.invalidate_bindings();
+    bool resolved = b == 10;
+    state("a = { b = 15 }");
+    return first && cached && resolved && b == 15;
+}
+
+bool test_selector_bind_copy(elsa::state& state) {
+    state("a = { b = 5 }");
+    auto b = state["a"]["b"];
+    b.bind();
+    bool first = b == 5;
+    auto c = b;
+    auto d = std::move(b);
+    return first && c.bound() && d.bound() && c == 5 && d == 5;
+}
+
+bool test_state_chunk_cache(elsa::state& state) {
+    state.enable_chunk_cache(2);
+    state("x = 0");
+    for(int i = 0; i < 5; ++i) state("x = x + 1");
+    int x = state.call<int>("return x");
+    state.call<int>("return 1");
+    state.call<int>("return 2");
+    auto stats = state.chunk_cache_stats();
+    state.disable_chunk_cache();
+    state("x = x + 1");
+    auto disabled = state.chunk_cache_stats();
+    return x == 5 && stats.hits == 4 && stats.misses == 5 &&
+        stats.evictions == 3 && stats.size == 2 && disabled.size == 0 && state["x"] == 6;
+}
+
+bool test_utility_string_embedded_nul(elsa::state& state) {
+    const std::string value { "a\0b\0c", 5 };
+    elsa::utility::push(state, value);
+    lua_setglobal(state, "s");
+    int size = state.call<int>("return #s");
+    return size == 5 && static_cast<std::string>(state["s"]) == value;
+}
+
+bool test_utility_string_view(elsa::state& state) {
+    std::string_view source { "test string view" };
+    elsa::utility::push(state, source.substr(5, 6));
+    std::string_view view = elsa::utility::get<std::string_view>(state, -1);
+    bool result = view == "string";
+    lua_pop(state, 1);
+    state("s = 'a\\0b'");
+    return result && state["s"] == std::string_view("a\0b", 3);
+}
+
+bool test_utility_push_containers(elsa::state& state) {
+    std::vector<int> v { 1, 2, 3 };
+    std::array<double, 2> a { 0.5, 1.5 };
+    std::map<std::string, std::vector<std::string>> m { { "x", { "a", "b" } }, { "y", {} } };
+    elsa::utility::push(state, v);
+    lua_setglobal(state, "v");
+    elsa::utility::push(state, a);
+    lua_setglobal(state, "a");
+    elsa::utility::push(state, m);
+    lua_setglobal(state, "m");
+    return state.call<bool>("return #v == 3 and v[3] == 3 and a[1] + a[2] == 2 and "
+        "m.x[2] == 'b' and #m.y == 0");
+}
+
+bool test_utility_get_containers(elsa::state& state) {
+    state("t = { 1, 2, 3, 4 }; n = { a = { 1, 2 }, b = { 3 } }");
+    auto v = static_cast<std::vector<int>>(state["t"]);
+    auto a = static_cast<std::array<int, 2>>(state["t"]);
+    auto n = static_cast<std::unordered_map<std::string, std::vector<int>>>(state["n"]);
+    return v == std::vector<int> { 1, 2, 3, 4 } && a[1] == 2 &&
+        n.size() == 2 && n["a"] == std::vector<int> { 1, 2 } && n["b"][0] == 3;
+}
+
+bool test_utility_containers_roundtrip(elsa::state& state) {
+    std::vector<std::map<int, std::string>> value { { { 1, "a" } }, { { 2, "b" }, { 3, "c" } } };
+    elsa::utility::push(state, value);
+    auto result = elsa::utility::pop<std::vector<std::map<int, std::string>>>(state);
+    return result == value;
+}
+
+bool test_utility_array_transfer(elsa::state& state) {
+    std::vector<double> values(1000);
+    for(std::size_t i = 0; i < values.size(); ++i) values[i] = i * 0.5;
+    elsa::utility::push_array(state, values);
+    lua_setglobal(state, "values");
+    state("for i = 1, #values do values[i] = values[i] * 2 end");
+    std::vector<int> result(values.size());
+    lua_getglobal(state, "values");
+    auto read = elsa::utility::read_array(state, -1, result);
+    std::int32_t small[2] { 7, 8 };
+    elsa::utility::fill_array(state, -1, small, 2);
+    lua_pop(state, 1);
+    state("fractions = { 1.5, -2.5, 3 }");
+    int truncated[3] {};
+    lua_getglobal(state, "fractions");
+    elsa::utility::read_array(state, -1, truncated, 3);
+    lua_pop(state, 1);
+    return read == 1000 && result[0] == 0 && result[999] == 999 &&
+        truncated[0] == 1 && truncated[1] == -2 && truncated[2] == 3 &&
+        state.call<bool>("return #values == 2 and values[2] == 8");
+}
+
+static int add(int a, int b) {
+    return a + b;
+}
+struct math {
+    static double half(double x) {
+        return x / 2;
+    }
+};
+
+bool test_function_free(elsa::state& state) {
+    state.set_function("add", &add);
+    state("lib = {}");
+    state["lib"]["half"] = &math::half;
+    return state.call<int>("return add(2, 3)") == 5 && state.call<double>("return lib.half(3)") == 1.5;
+}
+
+bool test_function_lambda(elsa::state& state) {
+    int offset = 10;
+    std::string prefix { "prefix_" };
+    state.set_function("offset", [offset](int x) { return x + offset; });
+    state.set_function("concat", [prefix](const std::string& s) { return prefix + s; });
+    state.set_function("pair", [](int x) { return std::make_tuple(x, x * 2); });
+    int a, b;
+    std::tie(a, b) = state.call<int, int>("return pair(offset(1))");
+    return a == 11 && b == 22 && state.call<std::string>("return concat('x')") == "prefix_x";
+}
+
+bool test_function_exception(elsa::state& state) {
+    state.set_function("fail", []() -> int { throw std::runtime_error("failure"); });
+    bool success; std::string message;
+    std::tie(success, message) = state.call<bool, std::string>("return pcall(fail)");
+    return !success && message.find("failure") != std::string::npos;
+}
+
+struct vec2 {
+    float x, y;
+    vec2(float x, float y): x(x), y(y) {}
+    float dot(const vec2& rhs) const {
+        return x * rhs.x + y * rhs.y;
+    }
+    void scale(float factor) {
+        x *= factor;
+        y *= factor;
+    }
+    vec2 operator+(const vec2& rhs) const {
+        return { x + rhs.x, y + rhs.y };
+    }
+};
+
+static int destroyed { 0 };
+struct tracked {
+    ~tracked() {
+        ++destroyed;
+    }
+};
+
+template<> struct elsa::is_usertype<vec2>: std::true_type {};
+template<> struct elsa::is_usertype<tracked>: std::true_type {};
+
+bool test_usertype_methods(elsa::state& state) {
+    elsa::usertype<vec2> { state, "vec2" }
+        .constructor<float, float>()
+        .method("dot", &vec2::dot)
+        .method("scale", &vec2::scale)
+        .method("sum", [](const vec2& v) { return v.x + v.y; })
+        .meta("__add", &vec2::operator+)
+        .field("x", &vec2::x)
+        .field("y", &vec2::y, false);
+    state("a = vec2.new(1, 2); b = vec2.new(3, 4); a:scale(2); a.x = a.x + 1; c = a + b");
+    bool readonly = !state.call<bool>("return pcall(function() a.y = 0 end)");
+    bool message = state.call<std::string>("return select(2, pcall(function() a[true] = 0 end))").find("'boolean'") != std::string::npos;
+    return state.call<float>("return a:dot(b)") == 3 * 3 + 4 * 4 &&
+        state.call<float>("return c:sum()") == 6 + 8 && readonly && message;
+}
+
+bool test_usertype_push_get(elsa::state& state) {
+    elsa::usertype<vec2> { state }.field("x", &vec2::x);
+    vec2 value { 1, 2 };
+    elsa::utility::push(state, value);
+    lua_setglobal(state, "copy");
+    elsa::utility::push(state, &value);
+    lua_setglobal(state, "pointer");
+    state("copy.x = 5; pointer.x = 10");
+    vec2 copy = static_cast<vec2>(state["copy"]);
+    vec2* pointer = static_cast<vec2*>(state["pointer"]);
+    elsa::utility::push(state, tracked {});
+    lua_setglobal(state, "other");
+    vec2* mismatch = static_cast<vec2*>(state["other"]);
+    return copy.x == 5 && pointer == &value && value.x == 10 && mismatch == nullptr;
+}
+
+bool test_usertype_gc(elsa::state& state) {
+    destroyed = 0;
+    elsa::utility::push(state, tracked {});
+    int temporaries = destroyed;
+    lua_pop(state, 1);
+    state.collect_garbage();
+    return destroyed == temporaries + 1;
+}
+
+bool test_state_pool_lease(elsa::state& state) {
+    elsa::state_pool pool { 2, true, "counter = 0" };
+    {
+        auto a = pool.acquire();
+        auto b = pool.try_acquire();
+        auto c = pool.try_acquire();
+        if(!a || !b || c || *a == *b) return false;
+        (*a)("counter = counter + 1");
+        (*b)("counter = counter + 1");
+    }
+    auto stats = pool.stats();
+    auto d = pool.acquire();
+    return stats.in_use == 0 && stats.acquisitions == 2 && pool.stats().affinity_hits == 1 &&
+        d->call<int>("return counter") == 1;
+}
+
+bool test_state_pool_threads(elsa::state& state) {
+    elsa::state_pool pool { 2, true, "function work(x) return x + 1 end" };
+    std::atomic<int> sum { 0 };
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) threads.emplace_back([&]() {
+        for(int i = 0; i < 100; ++i) {
+            auto lease = pool.acquire();
+            sum += (*lease)["work"].call<int>(0);
+        }
+    });
+    for(auto& thread: threads) thread.join();
+    auto stats = pool.stats();
+    return sum == 400 && stats.acquisitions == 400 && stats.in_use == 0;
+}
+
+bool test_executor_submit(elsa::state& state) {
+    elsa::executor executor { 4, true, "lib = { square = function(x) return x * x end }" };
+    std::vector<std::future<int>> results;
+    for(int i = 0; i < 100; ++i) results.push_back(executor.submit<int>("lib.square", i));
+    int sum = 0;
+    for(auto& result: results) sum += result.get();
+    auto failed = executor.submit<int>("lib.missing");
+    bool thrown = false;
+    try { failed.get(); } catch(const std::runtime_error&) { thrown = true; }
+    return sum == 328350 && thrown && executor.stats().executed == 101;
+}
+
+bool test_actor_state(elsa::state& state) {
+    elsa::actor_state actor { true, "count = 0; function add(x) count = count + x; return count end", {}, 16, 8 };
+    std::vector<std::thread> producers;
+    for(int i = 0; i < 4; ++i) producers.emplace_back([&actor]() {
+        for(int j = 0; j < 100; ++j) actor.post("add", 1);
+    });
+    for(auto& producer: producers) producer.join();
+    auto total = actor.ask<int>("add", 0);
+    auto failed = actor.ask<int>("missing");
+    bool thrown = false;
+    try { failed.get(); } catch(const std::runtime_error&) { thrown = true; }
+    // the counters are updated after the batch of a call finishes
+    while(actor.stats().executed < 402) std::this_thread::yield();
+    const auto stats = actor.stats();
+    elsa::actor_state ordered { true, "last = 0; function next(x) if x == last + 1 then last = x end return last end", {}, 4, 2 };
+    for(int i = 1; i < 100; ++i) ordered.post("next", i);
+    auto last = ordered.ask<int>("next", 100);
+    return total.get() == 400 && thrown && stats.batches <= stats.executed && actor.capacity() == 16 &&
+        last.get() == 100;
+}
+bool test_executor_keyed(elsa::state& state) {
+    elsa::executor executor { 3, true, "count = 0; function add() count = count + 1; return count end" };
+    std::vector<std::future<int>> results;
+    for(int i = 0; i < 50; ++i) results.push_back(executor.submit_keyed<int>(7, "add"));
+    int last = 0;
+    bool ordered = true;
+    for(auto& result: results) {
+        int value = result.get();
+        ordered = ordered && value == last + 1;
+        last = value;
+    }
+    return ordered && last == 50;
+}
+
+
+bool test_thread_resume(elsa::state& state) {
+    state("function gen(n) for i = 1, n do coroutine.yield(i) end return 'done' end");
+    elsa::thread thread { state, state["gen"] };
+    int sum = 0;
+    thread.resume(3);
+    while(thread.status() == elsa::thread_status::suspended) {
+        sum += thread.get<int>();
+        thread.resume();
+    }
+    return sum == 6 && thread.status() == elsa::thread_status::finished && thread.get<std::string>() == "done";
+}
+
+bool test_thread_scheduler(elsa::state& state) {
+    state("count = 0; function step() for i = 1, 3 do count = count + 1; coroutine.yield() end end");
+    state("function fail() coroutine.yield(); error('failed') end");
+    elsa::scheduler scheduler;
+    scheduler.spawn({ state, state["step"] });
+    scheduler.spawn({ state, state["step"] });
+    scheduler.spawn({ state, state["fail"] });
+    const auto first = scheduler.run_batch(2);
+    scheduler.run();
+    state("function noop() coroutine.yield() end");
+    for(int i = 0; i < 10000; ++i) scheduler.spawn({ state, state["noop"] });
+    scheduler.run();
+    elsa::state other { true };
+    other("function step() end");
+    bool rejected = false;
+    try {
+        elsa::thread foreign { state, other["step"] };
+    }
+    catch(const std::runtime_error&) {
+        rejected = true;
+    }
+    return first == 2 && state["count"] == 6 && scheduler.error_count() == 1 && scheduler.size() == 0 && rejected;
+}
+
+#if defined(__cpp_impl_coroutine)
+elsa::detached await_thread(elsa::scheduler& scheduler, elsa::thread& thread, int& sum) {
+    while(thread.resumable()) sum += co_await elsa::next<int>(scheduler, thread);
+}
+
+bool test_thread_await(elsa::state& state) {
+    state("function gen() coroutine.yield(1); coroutine.yield(2); return 3 end");
+    elsa::scheduler scheduler;
+    elsa::thread thread { state, state["gen"] };
+    int sum = 0;
+    await_thread(scheduler, thread, sum);
+    scheduler.run();
+    return sum == 6;
+}
+
+bool test_thread_await_error(elsa::state& state) {
+    state("function gen() coroutine.yield(1); error('broken') end");
+    elsa::scheduler scheduler;
+    elsa::thread thread { state, state["gen"] };
+    std::string message;
+    elsa::detached::error_handler() = [&](std::exception_ptr error) {
+        try { std::rethrow_exception(error); } catch(const std::runtime_error& e) { message = e.what(); }
+    };
+    int sum = 0;
+    await_thread(scheduler, thread, sum);
+    scheduler.run();
+    elsa::detached::error_handler() = {};
+    return sum == 1 && message.find("broken") != std::string::npos && thread.status() == elsa::thread_status::error;
+}
+#endif
+
+
+bool test_state_allocator(elsa::state& state) {
+    elsa::state limited { elsa::allocator_policy { 1 << 20 }, true };
+    const auto before = limited.memory();
+    limited("t = {} for i = 1, 1000 do t[i] = tostring(i) end");
+    const auto after = limited.memory();
+    bool thrown = false;
+    try { limited("s = string.rep('x', 4 * 1024 * 1024)"); } catch(const std::runtime_error&) { thrown = true; }
+    const auto failed = limited.memory();
+    return before.live > 0 && after.live > before.live && after.allocations > before.allocations &&
+        after.peak >= after.live && thrown && failed.failures > 0 && failed.live <= failed.limit &&
+        state.memory().live > 0;
+}
+
+bool test_state_allocator_unpooled(elsa::state& state) {
+    elsa::state copy { state };
+    {
+        elsa::state unpooled { elsa::allocator_policy { 0, false }, true };
+        copy = unpooled;
+        unpooled("x = string.rep('y', 1000)");
+    }
+    copy("x = nil");
+    copy.collect_garbage();
+    const auto stats = copy.memory();
+    return stats.limit == 0 && stats.frees > 0 && stats.live < stats.peak;
+}
+
+bool test_state_custom_allocator(elsa::state& state) {
+    std::size_t allocations = 0;
+    auto allocate = [](void* ud, void* block, std::size_t, std::size_t nsize) -> void* {
+        if(nsize == 0) {
+            std::free(block);
+            return nullptr;
+        }
+        if(!block) ++*static_cast<std::size_t*>(ud);
+        return std::realloc(block, nsize);
+    };
+    elsa::state custom { +allocate, &allocations, true };
+    custom("x = string.rep('y', 1000)");
+    return allocations > 0 && static_cast<std::string>(custom["x"]).size() == 1000;
+}
+
+
+bool test_state_bytecode_cache(elsa::state& state) {
+    const auto directory = std::filesystem::temp_directory_path() / "elsa_test_bytecode";
+    const auto script = (directory / "script.lua").string();
+    std::filesystem::create_directories(directory);
+    std::ofstream { script } << "#!/usr/bin/env lua\nvalue = (value or 0) + 1\n";
+    auto run = [&]() {
+        elsa::state other;
+        other.enable_bytecode_cache((directory / "cache").string());
+        other.load(script);
+        return std::make_pair(other.call<int>("return value"), other.bytecode_cache_stats());
+    };
+    const auto first = run();
+    const auto second = run();
+    std::ofstream { script } << "value = 10\n";
+    const auto changed = run();
+    std::filesystem::remove_all(directory);
+    return first.first == 1 && first.second.misses == 1 && first.second.writes == 1 &&
+        second.first == 1 && second.second.hits == 1 &&
+        changed.first == 10 && changed.second.stale == 1 && changed.second.writes == 1;
+}
+
+
+bool test_state_load_mapped(elsa::state& state) {
+    const auto script = (std::filesystem::temp_directory_path() / "elsa_test_mapped.lua").string();
+    std::ofstream { script } << "#!/usr/bin/env lua\nmapped = 42\n";
+    state.load_mapped(script);
+    std::ofstream { script } << "\n\nerror('mapped')\n";
+    std::string message;
+    try { state.load_mapped(script); } catch(const std::runtime_error& e) { message = e.what(); }
+    std::filesystem::remove(script);
+    return state.call<int>("return mapped") == 42 && message.find("elsa_test_mapped.lua:3: mapped") != std::string::npos;
+}
+
+bool test_state_load_buffer(elsa::state& state) {
+    static const unsigned char embedded[] = { 'e', 'm', 'b', 'e', 'd', 'd', 'e', 'd', '=', '7' };
+    state.load_buffer(embedded, sizeof(embedded), "embedded.lua");
+    std::string message;
+    try { state.load_buffer("x = = 1", "generated"); } catch(const std::runtime_error& e) { message = e.what(); }
+    return state.call<int>("return embedded") == 7 && message.find("generated:1:") != std::string::npos;
+}
+
+
+bool test_selector_call_each(elsa::state& state) {
+    state("function score(x) if x == 3 then error('bad record') end return x * 2 end");
+    std::vector<int> inputs { 1, 2, 3, 4 };
+    std::vector<int> outputs;
+    auto errors = state["score"].call_each<int>(inputs, std::back_inserter(outputs));
+    return outputs == std::vector<int> { 2, 4, 0, 8 } && errors.size() == 1 && errors[0].index == 2 &&
+        errors[0].message.find("bad record") != std::string::npos;
+}
+
+bool test_selector_call_batch(elsa::state& state) {
+    state("function add(a, b) return a + b, a * b end");
+    std::vector<std::tuple<int, int>> inputs { { 1, 2 }, { 3, 4 } };
+    auto batch = state["add"].call_batch<int, int>(inputs);
+    return batch.errors.empty() && batch.results.size() == 2 &&
+        batch.results[1] == std::make_tuple(7, 12);
+}
+
+
+bool test_selector_try_call(elsa::state& state) {
+    state("function check(x) if x < 0 then error('negative') end return x end");
+    auto good = state["check"].try_call<int>(2);
+    auto bad = state["check"].try_call<int>(-1);
+    auto missing = state["missing"].try_call<>();
+    return good && *good == 2 && !bad && bad.error().status() == elsa::call_status::runtime &&
+        bad.error().message().find("negative") != std::string::npos && bad.value_or(7) == 7 &&
+        !missing && bad.error().traceback().empty();
+}
+
+bool test_selector_try_call_traced(elsa::state& state) {
+    state("function inner() error('deep') end\nfunction outer() inner() end");
+    auto failed = state["outer"].try_call_traced<>();
+    const auto traceback = failed.error().traceback();
+    return !failed && failed.error().message().find("deep") != std::string::npos &&
+        traceback.find("inner") != std::string::npos && traceback.find("outer") != std::string::npos;
+}
+
+bool test_state_try_load(elsa::state& state) {
+    auto loaded = state.try_load("/nonexistent/elsa/script.lua");
+    auto syntax = state.try_call<int>("return = 1");
+    auto value = state.try_call<int>("return 5");
+    // the stack is restored instead of cleared when exceptions unwind
+    lua_pushinteger(state, 1);
+    try { state("error('unwind')"); } catch(const std::runtime_error&) {}
+    const bool kept = lua_gettop(state) == 1;
+    lua_pop(state, 1);
+    return !loaded && loaded.error().status() == elsa::call_status::file &&
+        !syntax && syntax.error().status() == elsa::call_status::syntax && value && *value == 5 && kept;
+}
+
+
+bool test_profiler_calls(elsa::state& state) {
+    state("function leaf(x) return x + 1 end\nfunction work(n) local s = 0 for i = 1, n do s = leaf(s) end return s end");
+    elsa::profiler profiler;
+    profiler.attach(state, 0);
+    state["work"].call<int>(100);
+    profiler.detach();
+    state["work"].call<int>(100);
+    const auto top = profiler.top(10, elsa::profile_order::calls);
+    return !profiler.attached() && !top.empty() && top[0].calls == 100 &&
+        top[0].function.find("leaf") != std::string::npos && profiler.collapsed().empty();
+}
+
+bool test_profiler_errors(elsa::state& state) {
+    state("function fail() error('x') end\nfunction guarded(n) for i = 1, n do pcall(fail) end end\n"
+        "function work() local s = 0 for i = 1, 1000 do s = s + i end return s end");
+    elsa::profiler profiler;
+    profiler.attach(state, 0);
+    // frames unwound by errors get no return event, they must not pile up
+    state["guarded"].call<>(300);
+    for(int i = 0; i < 300; ++i) state["fail"].try_call<>();
+    state["work"].call<int>();
+    elsa::profiler second;
+    bool rejected = false;
+    try {
+        second.attach(state, 0);
+    }
+    catch(const std::runtime_error&) {
+        rejected = true;
+    }
+    profiler.detach();
+    for(const auto& entry: profiler.top(10, elsa::profile_order::calls)) {
+        if(entry.function.find("work") != std::string::npos) return rejected && entry.calls == 1 && entry.total_time > 0;
+    }
+    return false;
+}
+
+bool test_profiler_lifetime(elsa::state& state) {
+    elsa::profiler profiler;
+    {
+        elsa::state other;
+        other("function leaf() end");
+        profiler.attach(other, 0);
+    }
+    // the profiler holds a reference, the state is closed when it detaches
+    const bool attached = profiler.attached();
+    profiler.detach();
+    return attached && !profiler.attached();
+}
+
+bool test_profiler_samples(elsa::state& state) {
+    state("function spin(n) local s = 0 for i = 1, n do s = s + i end return s end");
+    elsa::profiler profiler;
+    profiler.attach(state, 100, false);
+    state["spin"].call<int>(100000);
+    profiler.detach();
+    const auto collapsed = profiler.collapsed();
+    const auto top = profiler.top(1, elsa::profile_order::samples);
+    return collapsed.find("spin") != std::string::npos && top.size() == 1 && top[0].samples > 0 &&
+        top[0].calls == 0 && profiler.summary().find("spin") != std::string::npos;
+}
+
+
+#if defined(ELSA_HAS_STATIC_PATHS)
+bool test_static_path(elsa::state& state) {
+    state("config = { limits = { max = 8 }, scale = function(x) return x * 2 end }");
+    elsa::path<"config", "limits", "max"> max { state };
+    auto scale = state.get<"config.scale">();
+    state.get<"config.limits.min">().set(2);
+    const auto references = state.references();
+    return max.get<int>() == 8 && scale.call<int>(4) == 8 && state.get<"config.limits.min">().get<int>() == 2 &&
+        state.get<"config.missing.deep">().get<std::string>().empty() && state.references() == references;
+}
+#endif
+
+
+bool test_serialize_roundtrip(elsa::state& state) {
+    state("shared = { 1, 2 } data = { 'a', 'b', n = 3.5, flag = true, [10] = -7, left = shared, right = shared } data.self = data");
+    lua_getglobal(state, "data");
+    const auto buffer = elsa::encode(state, -1);
+    lua_pop(state, 1);
+    elsa::state other;
+    elsa::decode(other, buffer);
+    lua_setglobal(other, "copy");
+    bool malformed = false;
+    try {
+        elsa::decode(other, buffer.substr(0, buffer.size() - 1));
+    }
+    catch(const std::runtime_error&) {
+        malformed = lua_gettop(other) == 0;
+    }
+    // a table with the pair [NaN] = true
+    const std::string nan_key { "\x01\x06\0\0\0\0\x01\0\0\0\x04\0\0\0\0\0\0\xf8\x7f\x02", 20 };
+    bool rejected = false;
+    try {
+        elsa::decode(other, nan_key);
+    }
+    catch(const std::runtime_error&) {
+        rejected = lua_gettop(other) == 0;
+    }
+    return malformed && rejected && other.call<bool>("return copy[1] == 'a' and copy[2] == 'b' and copy.n == 3.5 and copy[10] == -7 "
+        "and copy.flag and copy.left[2] == 2 and copy.left == copy.right and copy.self == copy");
+}
+
+bool test_serialize_copy_value(elsa::state& state) {
+    state("data = { name = 'elsa', list = { 1, 2, 3 } } data.again = data.list handler = function() end");
+    elsa::state other;
+    lua_getglobal(state, "data");
+    elsa::copy_value(state, -1, other);
+    lua_pop(state, 1);
+    lua_setglobal(other, "data");
+    bool unsupported = false;
+    try {
+        lua_getglobal(state, "handler");
+        elsa::copy_value(state, -1, other);
+    }
+    catch(const std::runtime_error&) {
+        unsupported = lua_gettop(other) == 0;
+    }
+    lua_pop(state, 1);
+    return unsupported && other.call<bool>("return data.name == 'elsa' and data.list[3] == 3 and data.list == data.again");
+}
+
+
+bool test_shared_data(elsa::state& state) {
+    std::shared_ptr<const elsa::shared_data> data;
+    {
+        elsa::state builder;
+        builder("config = { 'a', 'b', 'c', name = 'elsa', [2.5] = true, limits = { max = 8 } } config.self = config");
+        lua_getglobal(builder, "config");
+        data = elsa::shared_data::build(builder, -1);
+    }
+    elsa::state other;
+    state.share("config", data);
+    other.share("config", data);
+    const bool readonly = !state.call<bool>("return pcall(function() config.name = 'x' end)");
+    return readonly && data.use_count() == 3 && other.call<int>("return config.limits.max") == 8 &&
+        state.call<bool>("return #config == 3 and config[3] == 'c' and config[4] == nil and config[2.5] and "
+            "config.name == 'elsa' and config.self.self == config and config.missing == nil");
+}
+
+bool test_shared_data_float_keys(elsa::state& state) {
+    elsa::state builder;
+    builder("data = { 10, 20, 30, 40, [100] = 'far' }");
+    lua_getglobal(builder, "data");
+    state.share("data", elsa::shared_data::build(builder, -1));
+    lua_pop(builder, 1);
+    return state.call<bool>("return data[1.0] == 10 and data[#data / 2] == 20 and data[100.0] == 'far' and data[1.5] == nil");
+}
+
+bool test_shared_data_pairs(elsa::state& state) {
+    elsa::state builder;
+    builder("data = { 10, 20, x = 1, y = 2 }");
+    lua_getglobal(builder, "data");
+    state.share("data", elsa::shared_data::build(builder, -1));
+    lua_pop(builder, 1);
+    return state.call<int>("local sum = 0 for k, v in pairs(data) do sum = sum + v end return sum") == 33;
+}
+
+
+bool test_gc_step_for(elsa::state& state) {
+    auto gc = state.gc();
+    gc.stop();
+    state("garbage = {} for i = 1, 10000 do garbage[i] = { i } end garbage = nil");
+    const bool stopped = !gc.running();
+    // the garbage may have been created during a cycle already running, so run two
+    int finished = 0;
+    for(int i = 0; i < 10000 && finished < 2; ++i) finished += gc.step_for(std::chrono::microseconds { 200 });
+    const auto stats = gc.stats();
+    gc.restart();
+    return stopped && gc.running() && finished == 2 && stats.cycles == 2 && stats.steps > 0 &&
+        stats.collected > 0 && stats.max_step_time <= stats.step_time && stats.baseline <= stats.count;
+}
+
+
+bool test_selector_pairs(elsa::state& state) {
+    state("scores = { alice = 3, bob = 4, [1] = 5 }");
+    int sum = 0;
+    std::size_t keys = 0;
+    for(const auto& [name, score]: state["scores"].pairs<std::string, int>()) {
+        keys += name.size();
+        sum += score;
+    }
+    bool empty = true;
+    for(const auto& pair: state["missing"].pairs<int, int>()) empty = pair.first < 0;
+    return sum == 12 && keys == 9 && empty;
+}
+
+bool test_selector_ipairs(elsa::state& state) {
+    state("items = { 'a', 'b', 'c', nil, 'e' }");
+    std::string joined;
+    std::size_t last = 0;
+    for(const auto& [index, item]: state["items"].ipairs<std::string>()) {
+        joined += item;
+        last = index;
+    }
+    // leaving early restores the stack as well
+    for(const auto& item: state["items"].ipairs<std::string>()) if(item.first == 2) break;
+    return joined == "abc" && last == 3;
+}
+
+
+struct entity {
+    float x { 0 };
+    int hp { 0 };
+    std::string name { "unnamed" };
+};
+namespace elsa {
+    template<> struct table_fields<entity> {
+        static constexpr auto members = std::make_tuple(field { "x", &entity::x }, field { "hp", &entity::hp },
+            field { "name", &entity::name });
+    };
+}
+
+bool test_selector_assign(elsa::state& state) {
+    state("cfg = { limits = {} }");
+    state["cfg"]["limits"]["max"] = 5;
+    state["cfg"]["name"] = "elsa";
+    state["cfg"]["weights"] = std::vector<double> { 0.5, 1.5 };
+    state["cfg"]["limits"].set_many("min", 1, "step", 2.5, 3, true);
+    return state.call<bool>("return cfg.limits.max == 5 and cfg.name == 'elsa' and cfg.weights[2] == 1.5 and "
+        "cfg.limits.min == 1 and cfg.limits.step == 2.5 and cfg.limits[3] == true");
+}
+
+bool test_selector_assign_selector(elsa::state& state) {
+    state("a = 1 b = { c = 'text' } t = {}");
+    state["a"] = state["b"]["c"];
+    auto target = state["t"]["x"];
+    auto source = state["b"];
+    target = source;
+    elsa::state other;
+    other("value = 42");
+    state["copied"] = other["value"];
+    auto moved = state["a"];
+    moved.retarget(state["copied"]);
+    state("cfg = { limits = { max = 1 } } defaults = { max = 5 }");
+    auto max = state.select("cfg.limits.max", '.');
+    max = state.select("defaults", "max");
+    return state.call<bool>("return a == 'text' and t.x == b and copied == 42 and cfg.limits.max == 5") &&
+        static_cast<int>(moved) == 42 && max == 5;
+}
+
+bool test_table_fields(elsa::state& state) {
+    state["entities"] = std::vector<entity> { { 1.5f, 2, "a" }, { 3.5f, 4, "b" } };
+    const bool pushed = state.call<bool>("return #entities == 2 and entities[2].x == 3.5 and entities[2].hp == 4 and "
+        "entities[1].name == 'a'");
+    state("entities[1].hp = 10 entities[1].name = nil");
+    const auto entities = static_cast<std::vector<entity>>(state["entities"]);
+    return pushed && entities.size() == 2 && entities[0].hp == 10 && entities[0].name == "unnamed" && entities[1].x == 3.5f;
+}
+
+
+bool test_state_ref(elsa::state& state) {
+    state("value = 3");
+    elsa::state_ref view { state };
+    elsa::state_ref copy { view };
+    auto sel = copy["value"];
+    auto other = sel;
+    return state.references() == 1 && view.references() == 0 && !view.owning() &&
+        static_cast<int>(other) == 3 && view == state;
+}
+
 
 static const std::vector<std::pair<
 const std::string, const std::function<bool(elsa::state&)>>> tests {
@@ -223,6 +996,7 @@ const std::string, const std::function<bool(elsa::state&)>>> tests {
     { "test_state_move_reassignment", test_state_move_reassignment },
     { "test_state_copy_weak", test_state_copy_weak },
     { "test_state_compare", test_state_compare },
+    { "test_state_ref", test_state_ref },
     
     { "test_state_run_code", test_state_run_code },
     { "test_state_call_return_0", test_state_call_return_0 },
@@ -248,7 +1022,84 @@ const std::string, const std::function<bool(elsa::state&)>>> tests {
     { "test_call_args", test_call_args },
     
     { "test_call_nested_tuple", test_call_nested_tuple },
-    { "test_call_multiple_times", test_call_multiple_times }
+    { "test_call_multiple_times", test_call_multiple_times },
+    
+    { "test_selector_bind", test_selector_bind },
+    { "test_selector_bind_invalidate", test_selector_bind_invalidate },
+    { "test_selector_bind_call", test_selector_bind_call },
+    { "test_selector_bind_copy", test_selector_bind_copy },
+    
+    { "test_state_chunk_cache", test_state_chunk_cache },
+    
+    { "test_utility_string_embedded_nul", test_utility_string_embedded_nul },
+    { "test_utility_string_view", test_utility_string_view },
+    
+    { "test_utility_push_containers", test_utility_push_containers },
+    { "test_utility_get_containers", test_utility_get_containers },
+    { "test_utility_containers_roundtrip", test_utility_containers_roundtrip },
+    
+    { "test_utility_array_transfer", test_utility_array_transfer },
+    
+    { "test_function_free", test_function_free },
+    { "test_function_lambda", test_function_lambda },
+    { "test_function_exception", test_function_exception },
+    
+    { "test_usertype_methods", test_usertype_methods },
+    { "test_usertype_push_get", test_usertype_push_get },
+    { "test_usertype_gc", test_usertype_gc },
+    { "test_gc_step_for", test_gc_step_for },
+    
+    { "test_state_pool_lease", test_state_pool_lease },
+    { "test_state_pool_threads", test_state_pool_threads },
+    
+    { "test_executor_submit", test_executor_submit },
+    { "test_executor_keyed", test_executor_keyed },
+    { "test_actor_state", test_actor_state },
+    
+    { "test_selector_try_call", test_selector_try_call },
+    { "test_selector_try_call_traced", test_selector_try_call_traced },
+    { "test_state_try_load", test_state_try_load },
+    
+#if defined(ELSA_HAS_STATIC_PATHS)
+    { "test_static_path", test_static_path },
+#endif
+    
+    { "test_serialize_roundtrip", test_serialize_roundtrip },
+    { "test_serialize_copy_value", test_serialize_copy_value },
+    
+    { "test_shared_data", test_shared_data },
+    { "test_shared_data_float_keys", test_shared_data_float_keys },
+#if LUA_VERSION_NUM >= 502
+    { "test_shared_data_pairs", test_shared_data_pairs },
+#endif
+    
+    { "test_selector_call_each", test_selector_call_each },
+    { "test_selector_call_batch", test_selector_call_batch },
+    { "test_selector_pairs", test_selector_pairs },
+    { "test_selector_ipairs", test_selector_ipairs },
+    { "test_selector_assign", test_selector_assign },
+    { "test_selector_assign_selector", test_selector_assign_selector },
+    { "test_table_fields", test_table_fields },
+    
+    { "test_state_bytecode_cache", test_state_bytecode_cache },
+    { "test_state_load_mapped", test_state_load_mapped },
+    { "test_state_load_buffer", test_state_load_buffer },
+    
+    { "test_profiler_calls", test_profiler_calls },
+    { "test_profiler_samples", test_profiler_samples },
+    { "test_profiler_errors", test_profiler_errors },
+    { "test_profiler_lifetime", test_profiler_lifetime },
+    
+    { "test_state_allocator", test_state_allocator },
+    { "test_state_allocator_unpooled", test_state_allocator_unpooled },
+    { "test_state_custom_allocator", test_state_custom_allocator },
+    
+    { "test_thread_resume", test_thread_resume },
+#if defined(__cpp_impl_coroutine)
+    { "test_thread_await", test_thread_await },
+    { "test_thread_await_error", test_thread_await_error },
+#endif
+    { "test_thread_scheduler", test_thread_scheduler }
 };
 
 #if defined(COLOURED_OUTPUT)